@@ -18,16 +18,49 @@
 
 // @author Stephane Rochon
 
-#include "mbed.h"
+#ifndef TFT_4DGL_H
+#define TFT_4DGL_H
 
-// Debug Verbose on terminal enabled
+#include "TFT_4DGL_Transport.h"
+
+// Debug Verbose on terminal, build with DEBUGMODE=1 to enable it. It prints
+// every command on the USB serial port, which slows the screen down.
 #ifndef DEBUGMODE
-#define DEBUGMODE 1
+#define DEBUGMODE 0
 #endif
 
 // Common WAIT value in millisecond
 #define TEMPO 5
 
+// Screen bring-up : give up after RESET_TIMEOUT ms, probing with autobaud every PROBE_TIMEOUT ms
+#define RESET_TIMEOUT 3000
+#define PROBE_TIMEOUT 50
+
+// ACKs a batch may leave unread, below the 16 byte receive FIFO of the UART
+#define ACK_WINDOW 12
+
+// Reply deadlines in ms : most commands, then clearing or copying large areas.
+// WAITTOUCH gets its own delay on top of REPLY_TIMEOUT.
+#define REPLY_TIMEOUT      100
+#define SLOW_REPLY_TIMEOUT 1000
+// Recovery after a lost or garbled reply : silence that ends a drain in ms,
+// version probes sent to realign the screen's parser, and times the command
+// is sent again. All of it fits in RESYNC_LIMIT_MS, so no command waits
+// longer than its reply deadline plus RESYNC_LIMIT_MS.
+#define RESYNC_QUIET       10
+#define RESYNC_PROBES      8
+#define REPLY_RETRIES      1
+#define RESYNC_LIMIT_MS    500
+
+// Display control modes whose last value is kept, 0x00 to 0x0F
+#define SHADOW_CONTROLS 16
+// Shadowed setting not known since the last reset
+#define SHADOW_UNKNOWN  -1
+
+// Longest string a text command carries, the SGC's own limit; the command
+// is built on the stack, so this bounds what a string call takes there
+#define STRING_MAX      256
+
 // 4DGL Functions values
 #define AUTOBAUD     '\x55'
 #define CLS          '\x45'
@@ -55,6 +88,7 @@
 #define GETTOUCH     '\x6F'
 #define WAITTOUCH    '\x77'
 #define SETTOUCH     '\x75'
+#define DISPIMAGE    '\x49'
 
 
 // Screen answers
@@ -73,6 +107,10 @@
 #define TRANSPARENT  '\x00'
 #define OPAQUE       '\x01'
 
+// Display image colour modes
+#define COLOR_8BIT   '\x08'                 // 1 byte a pixel, RRRGGGBB
+#define COLOR_16BIT  '\x10'                 // 2 bytes a pixel, RGB565 MSB first
+
 // Fonts Sizes
 #define FONT_5X7     '\x00'
 #define FONT_8X8     '\x01'
@@ -124,14 +162,28 @@
 #define IMAGE_FORMAT '\x06'
 #define PROTECT_FAT  '\x08'
 
-// change this to your specific screen (newer versions) if needed
-// Startup orientation is PORTRAIT so SIZE_X must be lesser than SIZE_Y
-#define SIZE_X       240
-#define SIZE_Y       320
+#define RESOLUTION   '\x0C'                 // uVGA only
+
+// uVGA resolutions
+#define RES_320X240  '\x00'
+#define RES_640X480  '\x01'
+#define RES_800X480  '\x02'
+
+// Clip rectangles push_clip() can nest
+#define CLIP_DEPTH   4
+
+// Screen size used when the version answer has a resolution code the
+// driver does not know, in the native orientation
+#define DEFAULT_WIDTH  240
+#define DEFAULT_HEIGHT 320
 
 #define IS_LANDSCAPE 0
 #define IS_PORTRAIT  1
 
+// Text cell of each font in pixels, FONT_5X7 to FONT_12X16
+static const char font_cell_w[4] = { 6, 8,  8, 12 };
+static const char font_cell_h[4] = { 8, 8, 12, 16 };
+
 // Screen orientation
 #define LANDSCAPE    '\x01'
 #define LANDSCAPE_R  '\x02'
@@ -152,6 +204,37 @@
 #define PROTECT      '\x00'
 #define UNPROTECT    '\x02'
 
+// Image data formats, see tools/img2c.cpp
+#define IMAGE_RGB565  0                     // 2 bytes a pixel, RGB565 MSB first
+#define IMAGE_PALETTE 1                     // 1 byte a pixel, index into the palette
+#define IMAGE_RLE     2                     // (count, index) pairs over the palette, count 1 to 255
+
+// Bytes of pixel data decoded before each write to the link
+#define BLIT_CHUNK   64
+
+//**************************************************************************
+// An image kept in flash, as made by tools/img2c.cpp
+struct TFT_4DGL_Image {
+    short width;
+    short height;
+    char  format;                           // IMAGE_ value
+    short colors;                           // palette entries, 0 for IMAGE_RGB565
+    const unsigned short *palette;          // RGB565 colours
+    const unsigned char  *data;
+    int   size;                             // bytes of data
+};
+
+// RGB565 colour shown for a RRRGGGBB byte in COLOR_8BIT mode
+inline unsigned short color8_to_16(unsigned char c) {
+    int r = (c >> 5) & 7, g = (c >> 2) & 7, b = c & 3;
+    return ((r << 2 | r >> 1) << 11) | ((g << 3 | g) << 5) | (b << 3 | b << 1 | b >> 1);
+}
+
+// RRRGGGBB byte keeping the top bits of a RGB565 colour
+inline unsigned char color16_to_8(unsigned short c) {
+    return ((c >> 13) << 5) | (((c >> 8) & 7) << 2) | ((c >> 3) & 3);
+}
+
 //**************************************************************************
 // \class TFT_4DGL TFT_4DGL.h
 // \brief This is the main class. It shoud be used like this : TFT_4GDL myLCD(p9,p10,p11);
@@ -168,20 +251,31 @@ Example:
 *     myLCD.circle(120, 160, 80, WHITE);
 * }
 * @endcode
+*
+* The link to the screen is a template parameter (see TFT_4DGL_Transport.h),
+* so transport calls are resolved at compile time. TFT_4DGL itself is the
+* driver on the default transport.
 */
 
-class TFT_4DGL {
+template <class Transport>
+class TFT_4DGL_Base {
 
 public :
 
-    TFT_4DGL(PinName tx, PinName rx, PinName rst);
+/** Create the screen, reset it and bring the link up
+* @param speed Baud rate to switch to as soon as the screen answers, 0 to stay at 9600
+*/
+    TFT_4DGL_Base(PinName tx, PinName rx, PinName rst, int speed = 0);
+
+/** Link to the screen, e.g. to inspect a simulator or a recording */
+    Transport &transport() { return _cmd; }
 
 // General Commands *******************************************************************************
 
 /** Clear the entire screen using the current background colour */
     void cls();
 
-/** Reset screen */
+/** Reset screen, then poll it with autobaud until it answers */
     void reset();
     
 /** Launch Autobaud for serial communication. This function is automatically called at startup */
@@ -191,6 +285,42 @@ public :
 */   
     void baudrate(int speed);
 
+/** Send the following commands back to back without waiting for each ACK.
+* Only commands answered by a single ACK may be sent this way.
+*/
+    void batch_begin();
+/** Collect the ACKs of a batch
+* @return number of commands acknowledged
+*/
+    int  batch_end();
+/** Read the batch ACKs that have already arrived, without waiting
+* @return number of ACKs still outstanding
+*/
+    int  poll_acks();
+/** ACKs still outstanding in the current batch */
+    int  pending() { return pending_acks; }
+
+/** Forget the screen settings the driver keeps, so the next setting commands
+* are all sent. reset() and autobaud() do it; call it when the screen may
+* have been reset or reconnected behind the driver.
+*/
+    void invalidate_state();
+
+/** Set the screen size in its native orientation, instead of the one it reports.
+* Also done by display_control(RESOLUTION, ...) on uVGA screens.
+*/
+    void set_geometry(int width, int height);
+
+/** Restrict drawing to a rectangle within the current one, e.g. to keep a HUD
+* clear. Lines and rectangles are clipped to it on the mbed, other shapes are
+* dropped when their bounding box misses it.
+* @return 0 when CLIP_DEPTH rectangles are already pushed
+*/
+    int push_clip(int x1, int y1, int x2, int y2);
+
+/** Go back to the clip rectangle before the last push_clip() */
+    void pop_clip();
+
 /** Set background colour to the specified value
 * @param color in HEX RGB like 0xFF00FF
 */
@@ -226,14 +356,27 @@ public :
     void screen_copy(int, int, int, int, int, int);
     void pen_size(char);
 
+/** Draw width x height pixels sent as they are, in one command and one ACK.
+* Only the rows and columns inside the clip rectangle are sent.
+* @param mode COLOR_8BIT or COLOR_16BIT
+* @return 1 if the screen took it, -1 on NAK, 0 without an answer
+*/
+    int  display_image(int x, int y, int width, int height, char mode, const char *data);
+/** Draw an image from flash, decoding palette and RLE data on the fly. A
+* palette whose colours all exist in COLOR_8BIT mode is sent 1 byte a pixel,
+* and only the rows and columns inside the clip rectangle.
+* @return 1 if the screen took it, -1 on NAK, 0 without an answer
+*/
+    int  blit(int x, int y, const TFT_4DGL_Image *image);
+
 // Texts Commands
     void set_font(char);
     void text_mode(char);
     void text_char(char, char, char, int);
     void graphic_char(char, int, int, int, char, char);
-    void text_string(char *, char, char, char, int);
-    void graphic_string(char *, int, int, char, int, char, char);
-    void text_button(char *, char, int, int, int, char, int, char, char);
+    void text_string(const char *, char, char, char, int);
+    void graphic_string(const char *, int, int, char, int, char, char);
+    void text_button(const char *, char, int, int, int, char, int, char, char);
 
     void locate(char, char);
     void color(int);
@@ -247,6 +390,32 @@ public :
     void set_touch(int, int, int, int);
     int  touch_status(void);
 
+// Boot timeline, in ms since construction
+    int boot_probes;        // autobaud probes sent before the screen answered
+    int boot_ready_ms;      // screen answered autobaud
+    int boot_baud_ms;       // link running at the requested speed
+    int boot_done_ms;       // version read, configured and cleared
+
+// Batch statistics
+    int acked;              // batch ACKs collected
+    int ack_stalls;         // batched commands that waited for room in the ACK window
+
+// Setting commands not sent because the screen already had that setting
+    int state_skipped;
+    int state_bytes_saved;
+
+// Link errors
+    int reply_timeouts;     // replies missing or short at their deadline
+    int reply_errors;       // reply bytes that were neither ACK nor NAK
+    int late_replies;       // commands that found bytes left from an earlier reply
+    int retries;            // commands sent again after a resync
+    int resyncs;            // recoveries started
+    int resync_failures;    // recoveries that ran out of probes or time
+    int max_stall_ms;       // longest wait for one reply, recovery included
+
+/** Time since construction in ms, to complete the boot timeline */
+    int boot_elapsed_ms();
+
 // Screen Data
     int type;
     int revision;
@@ -254,23 +423,75 @@ public :
     int reserved1;
     int reserved2;
 
+// Screen size in the current orientation, in pixels
+    int screen_width;
+    int screen_height;
+
+// Draw commands not sent because they were entirely outside the clip rectangle
+// or the screen, and the ones sent with their coordinates cut to it
+    int culled;
+    int clipped;
+
 // Text data
     char current_col;
     char current_row;
     int  current_color;
     char current_font;
     char current_orientation;
-    char max_col;
-    char max_row;
+    int  max_col;
+    int  max_row;
 
 protected :
 
-    Serial     _cmd;
-    DigitalOut _rst;
-
-    void freeBUFFER  (void);
+    Transport  _cmd;
+    int        _boot;   // read_ms() at construction
+
+    int batching;
+    int pending_acks;
+
+    // Last font, text mode, pen size, background and display controls sent,
+    // SHADOW_UNKNOWN until sent. Setting commands (set_font, text_mode,
+    // pen_size, background_color, display_control) are skipped when the
+    // screen already has the value; cls() changes none of them.
+    int shadow_font;
+    int shadow_text_mode;
+    int shadow_pen;
+    int shadow_background;
+    int shadow_control[SHADOW_CONTROLS];
+
+    int  same_state  (int *, int, int);
+
+    // Screen size in each orientation, and text cells of each font in each,
+    // worked out whenever the geometry changes rather than per command
+    int  orient_width[2];
+    int  orient_height[2];
+    int  font_cols[2][4];
+    int  font_rows[2][4];
+
+    // Clip rectangle, on top of the screen bounds, and the ones pushed before it
+    int  clip_x1, clip_y1, clip_x2, clip_y2;
+    int  clip_stack[CLIP_DEPTH][4];
+    int  clip_depth;
+
+    void geometry    (int, int);
+    void orient      (void);
+    void viewport    (int *, int *, int *, int *);
+    int  outside     (int, int, int, int);
+    int  clip_line   (int *, int *, int *, int *);
+
+    int  freeBUFFER  (void);
     void writeBYTE   (char);
+    void writeBUFFER (char *, int);
     int  writeCOMMAND(char *, int);
+    void ackROOM     (void);
+    int  writeIMAGE  (int, int, int, int, char, const TFT_4DGL_Image *, const char *);
+    int  readACK     (int);
+    int  readREPLY   (char *, int, int);
+    int  transact    (char *, int, char *);
+    int  resync      (int);
+    int  drain       (int);
+    int  replyLENGTH (char *, int);
+    int  replyTIMEOUT(char *, int);
     int  readVERSION (char *, int);
     void getTOUCH    (char *, int, int *,int *);
     int  getSTATUS   (char *, int);
@@ -280,4 +501,8 @@ protected :
 #endif // DEBUGMODE
 };
 
-typedef unsigned char BYTE;
\ No newline at end of file
+typedef TFT_4DGL_Base<TFT_4DGL_TRANSPORT> TFT_4DGL;
+
+typedef unsigned char BYTE;
+
+#endif
@@ -0,0 +1,161 @@
+//
+// TFT_4DGL is a class to drive 4D Systems TFT touch screens
+//
+// Copyright (C) <2010> Stephane ROCHON <stephane.rochon at free.fr>
+//
+// TFT_4DGL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TFT_4DGL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TFT_4DGL.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "TFT_4DGL_Transport.h"
+
+#if TFT_4DGL_DMA
+
+// GPDMA channel used for transmit
+#define DMA_CHANNEL  0
+#define DMA_CH       LPC_GPDMACH0
+
+DmaTransport *DmaTransport::_active = 0;
+
+//******************************************************************************************************
+DmaTransport :: DmaTransport(PinName tx, PinName rx, PinName rst) : _serial(tx, rx),
+                                                                    _rst(rst) {
+    _clock.start();
+
+    transfers  = 0;
+    _length[0] = 0;
+    _length[1] = 0;
+    _filling   = 0;
+    _sending   = 1;
+    _busy      = 0;
+
+    switch (tx) {                                   // UART behind the tx pin
+        case USBTX :
+            _uart    = (LPC_UART_TypeDef *)LPC_UART0;
+            _request = 8;
+            break;
+        case p13 :
+            _uart    = (LPC_UART_TypeDef *)LPC_UART1;
+            _request = 10;
+            break;
+        case p28 :
+            _uart    = LPC_UART2;
+            _request = 12;
+            break;
+        case p9 :
+            _uart    = LPC_UART3;
+            _request = 14;
+            break;
+        default :
+            error("TFT_4DGL: no UART transmits on this pin\n");
+    }
+
+    LPC_SC->PCONP     |= 1 << 29;                   // power up the GPDMA
+    LPC_SC->DMAREQSEL &= ~(1 << (_request - 8));    // request from the UART, not the timer match
+    LPC_GPDMA->DMACConfig = 1;                      // enable controller, little endian
+    while (!(LPC_GPDMA->DMACConfig & 1));
+
+    _uart->FCR = 0x01 | 0x08;                       // keep FIFOs on, DMA mode
+
+    _active = this;
+    NVIC_SetVector(DMA_IRQn, (uint32_t)&DmaTransport::isr);
+    NVIC_EnableIRQ(DMA_IRQn);
+}
+
+//******************************************************************************************************
+void DmaTransport :: kick() {                       // call with interrupts off
+
+    if (_busy || _length[_filling] == 0) return;
+
+    _sending = _filling;
+    _filling = !_filling;
+    _busy    = 1;
+    transfers++;
+
+    LPC_GPDMA->DMACIntTCClear = 1 << DMA_CHANNEL;
+    LPC_GPDMA->DMACIntErrClr  = 1 << DMA_CHANNEL;
+
+    DMA_CH->DMACCSrcAddr  = (uint32_t)_buffer[_sending];
+    DMA_CH->DMACCDestAddr = (uint32_t)&_uart->THR;
+    DMA_CH->DMACCLLI      = 0;
+    DMA_CH->DMACCControl  = (_length[_sending] & 0xFFF)  // transfer size, byte wide, burst of 1
+                          | (1 << 26)                    // increment source
+                          | (1u << 31);                  // terminal count interrupt
+    DMA_CH->DMACCConfig   = 1                            // enable channel
+                          | (_request << 6)              // destination request line
+                          | (1 << 11)                    // memory to peripheral
+                          | (1 << 14)                    // error interrupt
+                          | (1 << 15);                   // terminal count interrupt
+}
+
+//******************************************************************************************************
+void DmaTransport :: start() {
+
+    __disable_irq();
+    kick();
+    __enable_irq();
+}
+
+//******************************************************************************************************
+void DmaTransport :: isr() {                        // transfer done, send what filled meanwhile
+
+    LPC_GPDMA->DMACIntTCClear = 1 << DMA_CHANNEL;
+    LPC_GPDMA->DMACIntErrClr  = 1 << DMA_CHANNEL;
+
+    DmaTransport *t = _active;
+    if (!t) return;
+
+    t->_length[t->_sending] = 0;
+    t->_busy = 0;
+    t->kick();
+}
+
+//******************************************************************************************************
+void DmaTransport :: write(const char *data, int n) {
+
+    while (n > 0) {
+        __disable_irq();
+        int f    = _filling;
+        int room = DMA_BUFFER - _length[f];
+        if (room == 0) {                            // both buffers full, wait for the channel
+            kick();
+            __enable_irq();
+            while (_length[_filling] == DMA_BUFFER);
+            continue;
+        }
+        int k = (n < room) ? n : room;
+        memcpy(&_buffer[f][_length[f]], data, k);
+        _length[f] += k;
+        __enable_irq();
+
+        data += k;
+        n    -= k;
+    }
+    start();
+}
+
+//******************************************************************************************************
+void DmaTransport :: flush() {
+
+    start();
+    while (_busy || _length[_filling]) start();
+    while (!(_uart->LSR & 0x40));                   // wait for the last byte to leave the shift register
+}
+
+//******************************************************************************************************
+void DmaTransport :: baud(int speed) {
+
+    flush();
+    _serial.baud(speed);
+}
+
+#endif // TFT_4DGL_DMA
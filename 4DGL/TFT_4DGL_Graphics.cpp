@@ -16,15 +16,21 @@
 // You should have received a copy of the GNU General Public License
 // along with TFT_4DGL.  If not, see <http://www.gnu.org/licenses/>.
 
-#include "mbed.h"
 #include "TFT_4DGL.h"
 
 #define ARRAY_SIZE(X) sizeof(X)/sizeof(X[0])
 
 //****************************************************************************************************
-void TFT_4DGL :: circle(int x, int y , int radius, int color) {   // draw a circle in (x,y)
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: circle(int x, int y , int radius, int color) {   // draw a circle in (x,y)
     char command[9]= "";
 
+    if (outside(x - radius, y - radius, x + radius, y + radius)) return;
+    if (x < 0 || y < 0) {                                 // a negative centre cannot be sent
+        culled++;
+        return;
+    }
+
     command[0] = CIRCLE;
 
     command[1] = (x >> 8) & 0xFF;
@@ -47,9 +53,20 @@ void TFT_4DGL :: circle(int x, int y , int radius, int color) {   // draw a circ
 }
 
 //****************************************************************************************************
-void TFT_4DGL :: triangle(int x1, int y1 , int x2, int y2, int x3, int y3, int color) {   // draw a traingle
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: triangle(int x1, int y1 , int x2, int y2, int x3, int y3, int color) {   // draw a traingle
     char command[15]= "";
 
+    int left   = (x1 < x2) ? ((x1 < x3) ? x1 : x3) : ((x2 < x3) ? x2 : x3);
+    int right  = (x1 > x2) ? ((x1 > x3) ? x1 : x3) : ((x2 > x3) ? x2 : x3);
+    int top    = (y1 < y2) ? ((y1 < y3) ? y1 : y3) : ((y2 < y3) ? y2 : y3);
+    int bottom = (y1 > y2) ? ((y1 > y3) ? y1 : y3) : ((y2 > y3) ? y2 : y3);
+    if (outside(left, top, right, bottom)) return;
+    if (left < 0 || top < 0) {                            // a negative corner cannot be sent
+        culled++;
+        return;
+    }
+
     command[0] = TRIANGLE;
 
     command[1] = (x1 >> 8) & 0xFF;
@@ -81,9 +98,20 @@ void TFT_4DGL :: triangle(int x1, int y1 , int x2, int y2, int x3, int y3, int c
 }
 
 //****************************************************************************************************
-void TFT_4DGL :: line(int x1, int y1 , int x2, int y2, int color) {   // draw a line
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: line(int x1, int y1 , int x2, int y2, int color) {   // draw a line
     char command[11]= "";
 
+    if (outside(x1, y1, x2, y2)) return;
+    switch (clip_line(&x1, &y1, &x2, &y2)) {
+        case 0 :                                          // the box touched the viewport, the line does not
+            culled++;
+            return;
+        case 2 :
+            clipped++;
+            break;
+    }
+
     command[0] = LINE;
 
     command[1] = (x1 >> 8) & 0xFF;
@@ -109,9 +137,80 @@ void TFT_4DGL :: line(int x1, int y1 , int x2, int y2, int color) {   // draw a
 }
 
 //****************************************************************************************************
-void TFT_4DGL :: rectangle(int x1, int y1 , int x2, int y2, int color) {   // draw a rectangle
+// Outcodes of a point against the viewport
+#define CLIP_LEFT    1
+#define CLIP_RIGHT   2
+#define CLIP_TOP     4
+#define CLIP_BOTTOM  8
+
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: clip_line(int *x1, int *y1, int *x2, int *y2) {   // Cohen-Sutherland : 0 rejected, 1 inside, 2 cut
+    int vx1, vy1, vx2, vy2;
+    int cut = 0;
+
+    viewport(&vx1, &vy1, &vx2, &vy2);
+
+    for (;;) {
+        int code1 = ((*x1 < vx1) ? CLIP_LEFT : (*x1 > vx2) ? CLIP_RIGHT : 0)
+                  | ((*y1 < vy1) ? CLIP_TOP  : (*y1 > vy2) ? CLIP_BOTTOM : 0);
+        int code2 = ((*x2 < vx1) ? CLIP_LEFT : (*x2 > vx2) ? CLIP_RIGHT : 0)
+                  | ((*y2 < vy1) ? CLIP_TOP  : (*y2 > vy2) ? CLIP_BOTTOM : 0);
+
+        if ((code1 | code2) == 0) return cut ? 2 : 1;
+        if (code1 & code2) return 0;                      // both ends on the same outer side
+
+        int code = code1 ? code1 : code2;                 // move an outer end onto the edge it crosses
+        int dx = *x2 - *x1, dy = *y2 - *y1;
+        int x, y;
+
+        if (code & CLIP_TOP) {
+            y = vy1;
+            x = *x1 + (int)((long long)dx * (y - *y1) / dy);
+        } else if (code & CLIP_BOTTOM) {
+            y = vy2;
+            x = *x1 + (int)((long long)dx * (y - *y1) / dy);
+        } else if (code & CLIP_LEFT) {
+            x = vx1;
+            y = *y1 + (int)((long long)dy * (x - *x1) / dx);
+        } else {
+            x = vx2;
+            y = *y1 + (int)((long long)dy * (x - *x1) / dx);
+        }
+
+        if (code == code1) { *x1 = x; *y1 = y; }
+        else               { *x2 = x; *y2 = y; }
+        cut = 1;
+    }
+}
+
+//****************************************************************************************************
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: rectangle(int x1, int y1 , int x2, int y2, int color) {   // draw a rectangle
     char command[11]= "";
 
+    if (outside(x1, y1, x2, y2)) return;
+
+    int vx1, vy1, vx2, vy2;
+
+    viewport(&vx1, &vy1, &vx2, &vy2);
+    if (x1 > x2) { int t = x1; x1 = x2; x2 = t; }
+    if (y1 > y2) { int t = y1; y1 = y2; y2 = t; }
+    if (x1 < vx1 || y1 < vy1 || x2 > vx2 || y2 > vy2) {
+        if (shadow_pen == WIREFRAME) {                    // the cut sides of an outline must not be drawn,
+                                                          // the pen is solid until set otherwise
+            line(x1, y1, x2, y1, color);
+            line(x2, y1, x2, y2, color);
+            line(x2, y2, x1, y2, color);
+            line(x1, y2, x1, y1, color);
+            return;
+        }
+        if (x1 < vx1) x1 = vx1;
+        if (y1 < vy1) y1 = vy1;
+        if (x2 > vx2) x2 = vx2;
+        if (y2 > vy2) y2 = vy2;
+        clipped++;
+    }
+
     command[0] = RECTANGLE;
 
     command[1] = (x1 >> 8) & 0xFF;
@@ -137,9 +236,16 @@ void TFT_4DGL :: rectangle(int x1, int y1 , int x2, int y2, int color) {   // dr
 }
 
 //****************************************************************************************************
-void TFT_4DGL :: ellipse(int x, int y , int radius_x, int radius_y, int color) {   // draw an ellipse
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: ellipse(int x, int y , int radius_x, int radius_y, int color) {   // draw an ellipse
     char command[11]= "";
 
+    if (outside(x - radius_x, y - radius_y, x + radius_x, y + radius_y)) return;
+    if (x < 0 || y < 0) {                                 // a negative centre cannot be sent
+        culled++;
+        return;
+    }
+
     command[0] = ELLIPSE;
 
     command[1] = (x >> 8) & 0xFF;
@@ -165,9 +271,12 @@ void TFT_4DGL :: ellipse(int x, int y , int radius_x, int radius_y, int color) {
 }
 
 //****************************************************************************************************
-void TFT_4DGL :: pixel(int x, int y, int color) {   // draw a pixel
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: pixel(int x, int y, int color) {   // draw a pixel
     char command[7]= "";
 
+    if (outside(x, y, x, y)) return;
+
     command[0] = PIXEL;
 
     command[1] = (x >> 8) & 0xFF;
@@ -187,7 +296,8 @@ void TFT_4DGL :: pixel(int x, int y, int color) {   // draw a pixel
 }
 
 //******************************************************************************************************
-int TFT_4DGL :: read_pixel(int x, int y) { // read screen info and populate data
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: read_pixel(int x, int y) { // read screen info and populate data
 
     char command[5]= "";
 
@@ -199,32 +309,41 @@ int TFT_4DGL :: read_pixel(int x, int y) { // read screen info and populate data
     command[3] = (y >> 8) & 0xFF;
     command[4] = y & 0xFF;
 
-    int i, temp = 0, color = 0, resp = 0;
+    int color = 0;
     char response[2] = "";
 
-    freeBUFFER();
-
-    for (i = 0; i < 5; i++) {                   // send all chars to serial port
-        writeBYTE(command[i]);
-    }
-
-    while (!_cmd.readable()) wait_ms(TEMPO);    // wait for screen answer
-
-    while (_cmd.readable() && resp < ARRAY_SIZE(response)) {
-        temp = _cmd.getc();
-        response[resp++] = (char)temp;
-    }
+    if (transact(command, 5, response) != 2) return -1;    // no answer, even after a resync
 
-    color = ((response[0] << 8) + response[1]);
+    color = ((response[0] & 0xFF) << 8) | (response[1] & 0xFF);
 
     return color; // WARNING : this is 16bits color, not 24bits... need to be fixed
 }
 
 //******************************************************************************************************
-void TFT_4DGL :: screen_copy(int xs, int ys , int xd, int yd , int width, int height) {
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: screen_copy(int xs, int ys , int xd, int yd , int width, int height) {
 
     char command[13]= "";
 
+    if (outside(xd, yd, xd + width - 1, yd + height - 1)) return;
+
+    int vx1, vy1, vx2, vy2, cut = 0;
+
+    viewport(&vx1, &vy1, &vx2, &vy2);
+    if (xd < vx1) { xs += vx1 - xd; width  -= vx1 - xd; xd = vx1; cut = 1; }   // destination within the viewport
+    if (yd < vy1) { ys += vy1 - yd; height -= vy1 - yd; yd = vy1; cut = 1; }
+    if (xd + width  - 1 > vx2) { width  = vx2 - xd + 1; cut = 1; }
+    if (yd + height - 1 > vy2) { height = vy2 - yd + 1; cut = 1; }
+    if (xs < 0) { xd -= xs; width  += xs; xs = 0; cut = 1; }                   // source within the screen
+    if (ys < 0) { yd -= ys; height += ys; ys = 0; cut = 1; }
+    if (xs + width  > screen_width)  { width  = screen_width  - xs; cut = 1; }
+    if (ys + height > screen_height) { height = screen_height - ys; cut = 1; }
+    if (width <= 0 || height <= 0) {                      // the source is off screen
+        culled++;
+        return;
+    }
+    if (cut) clipped++;
+
     command[0] = SCREENCOPY;
 
     command[1] = (xs >> 8) & 0xFF;
@@ -249,11 +368,161 @@ void TFT_4DGL :: screen_copy(int xs, int ys , int xd, int yd , int width, int he
 }
 
 //****************************************************************************************************
-void TFT_4DGL :: pen_size(char mode) {   // set pen to SOLID or WIREFRAME
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: pen_size(char mode) {   // set pen to SOLID or WIREFRAME
     char command[2]= "";
 
     command[0] = PENSIZE;
     command[1] = mode;
 
-    writeCOMMAND(command, 2);
-}
\ No newline at end of file
+    if (same_state(&shadow_pen, mode & 0xFF, 2)) return;
+    if (writeCOMMAND(command, 2) != 1) shadow_pen = SHADOW_UNKNOWN;
+}
+
+//****************************************************************************************************
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: display_image(int x, int y, int width, int height, char mode, const char *data) {   // draw raw pixels
+
+    return writeIMAGE(x, y, width, height, mode, 0, data);
+}
+
+//****************************************************************************************************
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: blit(int x, int y, const TFT_4DGL_Image *image) {   // draw an image from flash
+
+    char mode = COLOR_16BIT;
+
+    if (image->format != IMAGE_RGB565) {               // 1 byte a pixel if no colour changes
+        mode = COLOR_8BIT;
+        for (int i = 0; i < image->colors; i++) {
+            if (color8_to_16(color16_to_8(image->palette[i])) != image->palette[i]) {
+                mode = COLOR_16BIT;
+                break;
+            }
+        }
+    }
+    return writeIMAGE(x, y, image->width, image->height, mode, image, 0);
+}
+
+//****************************************************************************************************
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: writeIMAGE(int x, int y, int width, int height, char mode,
+                                           const TFT_4DGL_Image *image, const char *raw) {   // stream a display image command
+    char command[10]= "";
+    char chunk[BLIT_CHUNK];
+    int  count = 0;
+
+    if (outside(x, y, x + width - 1, y + height - 1)) return 1;   // nothing to draw
+
+    int vx1, vy1, vx2, vy2;
+
+    viewport(&vx1, &vy1, &vx2, &vy2);
+    int col1 = (x < vx1) ? vx1 - x : 0;                // visible columns and rows of the image
+    int row1 = (y < vy1) ? vy1 - y : 0;
+    int col2 = (x + width  - 1 > vx2) ? vx2 - x : width - 1;
+    int row2 = (y + height - 1 > vy2) ? vy2 - y : height - 1;
+    int cols = col2 - col1 + 1;
+    int rows = row2 - row1 + 1;
+    if (cols < width || rows < height) clipped++;
+
+    command[0] = DISPIMAGE;
+
+    command[1] = ((x + col1) >> 8) & 0xFF;
+    command[2] = (x + col1) & 0xFF;
+
+    command[3] = ((y + row1) >> 8) & 0xFF;
+    command[4] = (y + row1) & 0xFF;
+
+    command[5] = (cols >> 8) & 0xFF;
+    command[6] = cols & 0xFF;
+
+    command[7] = (rows >> 8) & 0xFF;
+    command[8] = rows & 0xFF;
+
+    command[9] = mode;
+
+    int depth = (mode == COLOR_16BIT) ? 2 : 1;
+
+    if (batching) ackROOM();                           // the ACK of a batched image is collected later
+    else if (freeBUFFER()) late_replies++;
+
+    writeBUFFER(command, 10);
+
+    if (raw && cols == width) {                        // already in the wire format
+        int size = cols * rows * depth;
+        raw += row1 * width * depth;
+        for (int sent = 0; sent < size; sent += BLIT_CHUNK)
+            writeBUFFER((char *)raw + sent, (size - sent < BLIT_CHUNK) ? size - sent : BLIT_CHUNK);
+    } else if (raw) {                                  // the visible part of each row
+        for (int row = row1; row <= row2; row++) {
+            const char *line = raw + (row * width + col1) * depth;
+            int size = cols * depth;
+            for (int sent = 0; sent < size; sent += BLIT_CHUNK)
+                writeBUFFER((char *)line + sent, (size - sent < BLIT_CHUNK) ? size - sent : BLIT_CHUNK);
+        }
+    } else {
+        int pixels = (row2 + 1) * width;               // decoding stops after the last visible row
+        int i = 0;                                     // position in image->data
+        int col = 0, row = 0;                          // of the next pixel decoded
+
+        while (pixels > 0) {
+            int run = 1;
+            unsigned short c = 0;
+            int step = (image->format == IMAGE_PALETTE) ? 1 : 2;   // bytes of the next entry
+
+            if (i + step > image->size) {              // data ended early, pad so the command still completes
+                run = pixels;
+            } else {
+                switch (image->format) {
+                    case IMAGE_RGB565 :
+                        c = (image->data[i] << 8) | image->data[i + 1];
+                        break;
+                    case IMAGE_PALETTE :
+                        c = image->palette[image->data[i]];
+                        break;
+                    default :                          // IMAGE_RLE
+                        run = image->data[i];
+                        c   = image->palette[image->data[i + 1]];
+                        break;
+                }
+                i += step;
+            }
+            if (run > pixels) run = pixels;
+            pixels -= run;
+
+            while (run-- > 0) {
+                int shown = (row >= row1 && col >= col1 && col <= col2);
+                if (++col == width) {
+                    col = 0;
+                    row++;
+                }
+                if (!shown) continue;
+                if (mode == COLOR_16BIT) {
+                    chunk[count++] = c >> 8;
+                    chunk[count++] = c & 0xFF;
+                } else {
+                    chunk[count++] = color16_to_8(c);
+                }
+                if (count > BLIT_CHUNK - 2) {
+                    writeBUFFER(chunk, count);
+                    count = 0;
+                }
+            }
+        }
+        if (count) writeBUFFER(chunk, count);
+    }
+
+    if (batching) {
+        pending_acks++;
+        return 1;
+    }
+
+    int resp = readACK(SLOW_REPLY_TIMEOUT);            // far longer than the last chunk takes to leave
+    if (resp == 0) {                                   // too large to send again, just realign
+        reply_timeouts++;
+        resync(_cmd.read_ms() + RESYNC_LIMIT_MS);
+    }
+    return resp;
+}
+
+#include "TFT_4DGL_Instances.h"
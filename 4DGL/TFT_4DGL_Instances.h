@@ -0,0 +1,29 @@
+//
+// TFT_4DGL is a class to drive 4D Systems TFT touch screens
+//
+// Copyright (C) <2010> Stephane ROCHON <stephane.rochon at free.fr>
+//
+// TFT_4DGL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TFT_4DGL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TFT_4DGL.  If not, see <http://www.gnu.org/licenses/>.
+
+// Transports the driver is built for. Included at the end of every
+// TFT_4DGL_*.cpp so the member functions can stay out of the header.
+
+#if TFT_4DGL_HOST
+template class TFT_4DGL_Base<MockTransport>;
+template class TFT_4DGL_Base<SimTransport>;
+template class TFT_4DGL_Base<RecordTransport<SimTransport> >;
+template class TFT_4DGL_Base<ReplayTransport>;
+#else
+template class TFT_4DGL_Base<TFT_4DGL_TRANSPORT>;
+#endif
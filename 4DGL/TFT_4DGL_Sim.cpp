@@ -0,0 +1,271 @@
+//
+// TFT_4DGL is a class to drive 4D Systems TFT touch screens
+//
+// Copyright (C) <2010> Stephane ROCHON <stephane.rochon at free.fr>
+//
+// TFT_4DGL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TFT_4DGL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TFT_4DGL.  If not, see <http://www.gnu.org/licenses/>.
+
+#include "TFT_4DGL.h"
+
+#if TFT_4DGL_HOST
+
+//******************************************************************************************************
+SimTransport :: SimTransport(PinName, PinName, PinName) {
+
+    commands  = 0;
+    bytes     = 0;
+    errors    = 0;
+    speed     = 9600;
+    _us       = 0;
+    _ready_us = 0;
+    _level    = 1;
+    _rx_head  = 0;
+    _rx_tail  = 0;
+    reset(1);
+}
+
+//******************************************************************************************************
+void SimTransport :: reset(int level) {             // screen restarts on the rising edge
+
+    if (level && !_level) _ready_us = _us + SIM_BOOT_MS * 1000L;
+    _level = level;
+
+    _background = 0;
+    _pen        = SOLID;
+    _count      = 0;
+    _image_left = 0;
+    _image_high = -1;
+    _rx_head    = 0;
+    _rx_tail    = 0;
+    fill(0, 0, SIM_WIDTH - 1, SIM_HEIGHT - 1, 0);
+}
+
+//******************************************************************************************************
+int SimTransport :: getc() {
+
+    if (_rx_head == _rx_tail) return -1;
+    unsigned char c = _rx[_rx_tail];
+    _rx_tail = (_rx_tail + 1) % sizeof(_rx);
+    return c;
+}
+
+//******************************************************************************************************
+void SimTransport :: answer(char c) {
+
+    _rx[_rx_head] = c;
+    _rx_head = (_rx_head + 1) % sizeof(_rx);
+}
+
+//******************************************************************************************************
+void SimTransport :: write(const char *data, int n) {
+
+    for (int i = 0; i < n; i++) {
+        _us += 10000000L / speed;                   // start, 8 data and stop bits on the wire
+        if (!_level || _us < _ready_us) continue;   // held in reset or still booting, byte lost
+
+        bytes++;
+        if (_image_left > 0) {                      // pixels are drawn as they come, not buffered
+            image(data[i]);
+            continue;
+        }
+        if (_count < (int)sizeof(_in)) _in[_count++] = data[i];
+
+        int len = length();
+        if (len < 0) {                              // not an opcode, drop it and stay in sync
+            errors++;
+            _count = 0;
+            answer(NAK);
+        } else if (len > 0 && _count >= len) {
+            execute();
+            _count = 0;
+        }
+    }
+}
+
+//******************************************************************************************************
+int SimTransport :: length() {                      // bytes in the command, 0 if not known yet, -1 if unknown
+
+    int fixed = 0;
+
+    switch (_in[0]) {
+        case AUTOBAUD :
+        case CLS :          return 1;
+        case BAUDRATE :
+        case VERSION :
+        case SETVOLUME :
+        case PENSIZE :
+        case SETFONT :
+        case TEXTMODE :
+        case GETTOUCH :     return 2;
+        case BCKGDCOLOR :
+        case DISPCONTROL :
+        case WAITTOUCH :    return 3;
+        case READPIXEL :    return 5;
+        case TEXTCHAR :     return 6;
+        case PIXEL :        return 7;
+        case CIRCLE :
+        case SETTOUCH :     return 9;
+        case GRAPHCHAR :
+        case DISPIMAGE :    return 10;              // image pixels follow, see image()
+        case LINE :
+        case RECTANGLE :
+        case ELLIPSE :      return 11;
+        case SCREENCOPY :   return 13;
+        case TRIANGLE :     return 15;
+        case TEXTSTRING :   fixed = 6;  break;      // followed by a null terminated string
+        case GRAPHSTRING :  fixed = 10; break;
+        case TEXTBUTTON :   fixed = 13; break;
+        default :           return -1;
+    }
+
+    if (_count > fixed && _in[_count - 1] == 0) return _count;
+    if (_count == (int)sizeof(_in)) return _count; // string too long, end it here
+    return 0;
+}
+
+//******************************************************************************************************
+void SimTransport :: execute() {
+
+    commands++;
+
+    switch (_in[0]) {
+        case CLS :
+            fill(0, 0, SIM_WIDTH - 1, SIM_HEIGHT - 1, _background);
+            break;
+        case BCKGDCOLOR :
+            _background = word(1);
+            break;
+        case PENSIZE :
+            _pen = _in[1];
+            break;
+        case PIXEL :
+            plot(word(1), word(3), word(5));
+            break;
+        case LINE :
+            line(word(1), word(3), word(5), word(7), word(9));
+            break;
+        case RECTANGLE : {
+            int x1 = word(1), y1 = word(3), x2 = word(5), y2 = word(7), c = word(9);
+            if (_pen == SOLID) {
+                fill(x1, y1, x2, y2, c);
+            } else {
+                line(x1, y1, x2, y1, c);
+                line(x2, y1, x2, y2, c);
+                line(x2, y2, x1, y2, c);
+                line(x1, y2, x1, y1, c);
+            }
+            break;
+        }
+        case SCREENCOPY : {
+            int xs = word(1), ys = word(3), xd = word(5), yd = word(7), w = word(9), h = word(11);
+            static unsigned short block[SIM_HEIGHT][SIM_WIDTH];
+            for (int y = 0; y < h; y++)             // copy out first, areas may overlap
+                for (int x = 0; x < w; x++)
+                    block[y % SIM_HEIGHT][x % SIM_WIDTH] = (xs + x < SIM_WIDTH && ys + y < SIM_HEIGHT) ? frame[ys + y][xs + x] : 0;
+            for (int y = 0; y < h; y++)
+                for (int x = 0; x < w; x++)
+                    plot(xd + x, yd + y, block[y % SIM_HEIGHT][x % SIM_WIDTH]);
+            break;
+        }
+        case DISPIMAGE :
+            _image_x    = word(1);
+            _image_y    = word(3);
+            _image_w    = word(5);
+            _image_mode = _in[9];
+            _image_pos  = 0;
+            _image_high = -1;
+            _image_left = word(5) * word(7) * (_image_mode == COLOR_16BIT ? 2 : 1);
+            if (_image_left > 0) return;            // ACK after the last pixel
+            break;
+        case READPIXEL : {
+            int x = word(1), y = word(3);
+            unsigned short c = (x < SIM_WIDTH && y < SIM_HEIGHT) ? frame[y][x] : 0;
+            answer(c >> 8);
+            answer(c & 0xFF);
+            return;
+        }
+        case VERSION :                              // uVGA, 320 x 240 resolution codes
+            answer(0x02);
+            answer(0x01);
+            answer(0x01);
+            answer(0x32);
+            answer(0x24);
+            return;
+        case GETTOUCH :
+            if (_in[1] == STATUS || _in[1] == GETPOSITION) {
+                for (int i = 0; i < 4; i++) answer(0);
+                return;
+            }
+            break;
+        default :                                   // text, circles and settings are accepted but not drawn
+            break;
+    }
+    answer(ACK);
+}
+
+//******************************************************************************************************
+void SimTransport :: image(unsigned char c) {
+
+    unsigned short color;
+
+    _image_left--;
+    if (_image_mode == COLOR_16BIT) {
+        if (_image_high < 0) {
+            _image_high = c;
+            return;
+        }
+        color = (_image_high << 8) | c;
+        _image_high = -1;
+    } else {
+        color = color8_to_16(c);
+    }
+    plot(_image_x + _image_pos % _image_w, _image_y + _image_pos / _image_w, color);
+    _image_pos++;
+
+    if (_image_left == 0) answer(ACK);
+}
+
+//******************************************************************************************************
+void SimTransport :: plot(int x, int y, unsigned short c) {
+
+    if (x >= 0 && x < SIM_WIDTH && y >= 0 && y < SIM_HEIGHT) frame[y][x] = c;
+}
+
+//******************************************************************************************************
+void SimTransport :: fill(int x1, int y1, int x2, int y2, unsigned short c) {
+
+    if (x1 > x2) { int t = x1; x1 = x2; x2 = t; }
+    if (y1 > y2) { int t = y1; y1 = y2; y2 = t; }
+    for (int y = y1; y <= y2; y++)
+        for (int x = x1; x <= x2; x++)
+            plot(x, y, c);
+}
+
+//******************************************************************************************************
+void SimTransport :: line(int x1, int y1, int x2, int y2, unsigned short c) {   // Bresenham
+
+    int dx = (x2 > x1) ? x2 - x1 : x1 - x2, sx = (x1 < x2) ? 1 : -1;
+    int dy = (y2 > y1) ? y1 - y2 : y2 - y1, sy = (y1 < y2) ? 1 : -1;
+    int err = dx + dy;
+
+    for (;;) {
+        plot(x1, y1, c);
+        if (x1 == x2 && y1 == y2) break;
+        int e2 = 2 * err;
+        if (e2 >= dy) { err += dy; x1 += sx; }
+        if (e2 <= dx) { err += dx; y1 += sy; }
+    }
+}
+
+#endif // TFT_4DGL_HOST
@@ -16,67 +16,45 @@
 // You should have received a copy of the GNU General Public License
 // along with TFT_4DGL.  If not, see <http://www.gnu.org/licenses/>.
 
-#include "mbed.h"
 #include "TFT_4DGL.h"
 
 //****************************************************************************************************
-void TFT_4DGL :: set_font(char mode) {   // set font size
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: set_font(char mode) {   // set font size
     char command[2]= "";
 
-    int w, h, fx = 8, fy = 8;
-
     command[0] = SETFONT;
     command[1] = mode;
 
     current_font = mode;
+    orient();                                             // text cells from the tables
 
-    if (current_orientation == IS_PORTRAIT) {
-        w = SIZE_X;
-        h = SIZE_Y;
-    } else {
-        w = SIZE_Y;
-        h = SIZE_X;
-    }
-
-    switch (mode) {
-        case FONT_5X7 :
-            fx = 6;
-            fy = 8;
-            break;
-        case FONT_8X8 :
-            fx = 8;
-            fy = 8;
-            break;
-        case FONT_8X12 :
-            fx = 8;
-            fy = 12;
-            break;
-        case FONT_12X16 :
-            fx = 12;
-            fy = 16;
-            break;
-    }
-
-    max_col = w / fx;
-    max_row = h / fy;
-
-    writeCOMMAND(command, 2);
+    if (same_state(&shadow_font, mode & 0xFF, 2)) return;
+    if (writeCOMMAND(command, 2) != 1) shadow_font = SHADOW_UNKNOWN;
 }
 
 //****************************************************************************************************
-void TFT_4DGL :: text_mode(char mode) {   // set text mode
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: text_mode(char mode) {   // set text mode
     char command[2]= "";
 
     command[0] = TEXTMODE;
     command[1] = mode;
 
-    writeCOMMAND(command, 2);
+    if (same_state(&shadow_text_mode, mode & 0xFF, 2)) return;
+    if (writeCOMMAND(command, 2) != 1) shadow_text_mode = SHADOW_UNKNOWN;
 }
 
 //****************************************************************************************************
-void TFT_4DGL :: text_char(char c, char col, char row, int color) {   // draw a text char
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: text_char(char c, char col, char row, int color) {   // draw a text char
     char command[6]= "";
 
+    if ((unsigned char)col >= max_col || (unsigned char)row >= max_row) {  // cell off screen
+        culled++;
+        return;
+    }
+
     command[0] = TEXTCHAR;
 
     command[1] = c;
@@ -90,13 +68,16 @@ void TFT_4DGL :: text_char(char c, char col, char row, int color) {   // draw a
     command[4] = ((red5 << 3)   + (green6 >> 3)) & 0xFF;  // first part of 16 bits color
     command[5] = ((green6 << 5) + (blue5 >>  0)) & 0xFF;  // second part of 16 bits color
 
-    writeCOMMAND(command, 8);
+    writeCOMMAND(command, 6);
 }
 
 //****************************************************************************************************
-void TFT_4DGL :: graphic_char(char c, int x, int y, int color, char width, char height) {   // draw a graphic char
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: graphic_char(char c, int x, int y, int color, char width, char height) {   // draw a graphic char
     char command[10]= "";
 
+    if (outside(x, y, x + font_cell_w[current_font & 3] * width - 1, y + font_cell_h[current_font & 3] * height - 1)) return;
+
     command[0] = GRAPHCHAR;
 
     command[1] = c;
@@ -122,10 +103,12 @@ void TFT_4DGL :: graphic_char(char c, int x, int y, int color, char width, char
 }
 
 //****************************************************************************************************
-void TFT_4DGL :: text_string(char *s, char col, char row, char font, int color) {   // draw a text string
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: text_string(const char *s, char col, char row, char font, int color) {   // draw a text string
 
-    char command[1000]= "";
+    char command[STRING_MAX + 11]= "";
     int size = strlen(s);
+    if (size > STRING_MAX) size = STRING_MAX;                  // longer strings are cut
     int i = 0;
 
     command[0] = TEXTSTRING;
@@ -150,10 +133,12 @@ void TFT_4DGL :: text_string(char *s, char col, char row, char font, int color)
 }
 
 //****************************************************************************************************
-void TFT_4DGL :: graphic_string(char *s, int x, int y, char font, int color, char width, char height) {   // draw a text string
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: graphic_string(const char *s, int x, int y, char font, int color, char width, char height) {   // draw a text string
 
-    char command[1000]= "";
+    char command[STRING_MAX + 11]= "";
     int size = strlen(s);
+    if (size > STRING_MAX) size = STRING_MAX;                  // longer strings are cut
     int i = 0;
 
     command[0] = GRAPHSTRING;
@@ -185,10 +170,12 @@ void TFT_4DGL :: graphic_string(char *s, int x, int y, char font, int color, cha
 }
 
 //****************************************************************************************************
-void TFT_4DGL :: text_button(char *s, char mode, int x, int y, int button_color, char font, int text_color, char width, char height) {   // draw a text string
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: text_button(const char *s, char mode, int x, int y, int button_color, char font, int text_color, char width, char height) {   // draw a text string
 
-    char command[1000]= "";
+    char command[STRING_MAX + 14]= "";
     int size = strlen(s);
+    if (size > STRING_MAX) size = STRING_MAX;                  // longer strings are cut
     int i = 0, red5, green6, blue5;
 
     command[0] = TEXTBUTTON;
@@ -229,18 +216,21 @@ void TFT_4DGL :: text_button(char *s, char mode, int x, int y, int button_color,
 }
 
 //****************************************************************************************************
-void TFT_4DGL :: locate(char col, char row) {   // place text curssor at col, row
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: locate(char col, char row) {   // place text curssor at col, row
     current_col = col;
     current_row = row;
 }
 
 //****************************************************************************************************
-void TFT_4DGL :: color(int color) {   // set text color
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: color(int color) {   // set text color
     current_color = color;
 }
 
 //****************************************************************************************************
-void TFT_4DGL :: putc(char c) {   // place char at current cursor position
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: putc(char c) {   // place char at current cursor position
 
     text_char(c, current_col++, current_row, current_color);
 
@@ -254,7 +244,8 @@ void TFT_4DGL :: putc(char c) {   // place char at current cursor position
 }
 
 //****************************************************************************************************
-void TFT_4DGL :: puts(char *s) {   // place string at current cursor position
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: puts(char *s) {   // place string at current cursor position
 
     text_string(s, current_col, current_row, current_font, current_color);
 
@@ -267,4 +258,6 @@ void TFT_4DGL :: puts(char *s) {   // place string at current cursor position
     if (current_row >= max_row) {
         current_row %= max_row;
     }
-}
\ No newline at end of file
+}
+
+#include "TFT_4DGL_Instances.h"
@@ -16,11 +16,11 @@
 // You should have received a copy of the GNU General Public License
 // along with TFT_4DGL.  If not, see <http://www.gnu.org/licenses/>.
 
-#include "mbed.h"
 #include "TFT_4DGL.h"
 
 //******************************************************************************************************
-void TFT_4DGL :: touch_mode(char mode) { // Send touch mode (WAIT, PRESS, RELEASE or MOVE)
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: touch_mode(char mode) { // Send touch mode (WAIT, PRESS, RELEASE or MOVE)
 
     char command[2]= "";
 
@@ -31,7 +31,8 @@ void TFT_4DGL :: touch_mode(char mode) { // Send touch mode (WAIT, PRESS, RELEAS
 }
 
 //******************************************************************************************************
-void TFT_4DGL :: get_touch(int *x, int *y) { // Get the touch coordinates
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: get_touch(int *x, int *y) { // Get the touch coordinates
 
     char command[2] = "";
     
@@ -42,7 +43,8 @@ void TFT_4DGL :: get_touch(int *x, int *y) { // Get the touch coordinates
 }
 
 //******************************************************************************************************
-int TFT_4DGL :: touch_status(void) { // Get the touch screen status
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: touch_status(void) { // Get the touch screen status
 
     char command[2] = "";
     
@@ -54,7 +56,8 @@ int TFT_4DGL :: touch_status(void) { // Get the touch screen status
 
 
 //******************************************************************************************************
-void TFT_4DGL :: wait_touch(int delay) { // wait until touch within a delay in milliseconds
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: wait_touch(int delay) { // wait until touch within a delay in milliseconds
 
     char command[3]= "";
 
@@ -67,7 +70,8 @@ void TFT_4DGL :: wait_touch(int delay) { // wait until touch within a delay in m
 }
 
 //******************************************************************************************************
-void TFT_4DGL :: set_touch(int x1, int y1 , int x2, int y2) { // define touch area
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: set_touch(int x1, int y1 , int x2, int y2) { // define touch area
 
     char command[9]= "";
 
@@ -86,4 +90,6 @@ void TFT_4DGL :: set_touch(int x1, int y1 , int x2, int y2) { // define touch ar
     command[8] = y2 & 0xFF;
 
     writeCOMMAND(command, 9);
-}
\ No newline at end of file
+}
+
+#include "TFT_4DGL_Instances.h"
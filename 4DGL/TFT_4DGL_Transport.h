@@ -0,0 +1,402 @@
+//
+// TFT_4DGL is a class to drive 4D Systems TFT touch screens
+//
+// Copyright (C) <2010> Stephane ROCHON <stephane.rochon at free.fr>
+//
+// TFT_4DGL is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// TFT_4DGL is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with TFT_4DGL.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TFT_4DGL_TRANSPORT_H
+#define TFT_4DGL_TRANSPORT_H
+
+// Build for a host computer instead of mbed, with one of the host transports as the link
+#ifndef TFT_4DGL_HOST
+#define TFT_4DGL_HOST 0
+#endif
+
+#if TFT_4DGL_HOST
+#include <string.h>
+typedef int PinName;
+#else
+#include "mbed.h"
+#endif
+
+// Send commands with the LPC1768 GPDMA controller instead of putc
+#ifndef TFT_4DGL_DMA
+#if defined(TARGET_LPC1768) && !TFT_4DGL_HOST
+#define TFT_4DGL_DMA 1
+#else
+#define TFT_4DGL_DMA 0
+#endif
+#endif
+
+//**************************************************************************
+// Transport interface
+//
+// TFT_4DGL talks to the screen only through a transport object, selected
+// at compile time with TFT_4DGL_TRANSPORT. Every transport provides :
+//
+//   Transport(PinName tx, PinName rx, PinName rst)
+//   void baud(int speed)                    set link speed, after flushing
+//   void write(const char *data, int n)     queue bytes, may return before they are sent
+//   void flush()                            block until all bytes are on the wire
+//   int  readable()                         1 when an answer byte is waiting
+//   int  getc()                             read one answer byte
+//   void reset(int level)                   drive the screen reset line
+//   void wait_ms(int ms)                    sleep
+//   int  read_ms()                          free running millisecond clock
+//**************************************************************************
+
+#if !TFT_4DGL_HOST
+//**************************************************************************
+// Byte by byte transmit with Serial::putc, the CPU is busy until the last byte
+class SerialTransport {
+
+public :
+
+    SerialTransport(PinName tx, PinName rx, PinName rst) : _serial(tx, rx), _rst(rst) {
+        _clock.start();
+#if defined(TARGET_LPC1768)
+        switch (tx) {                                 // UART behind the tx pin
+            case USBTX : _uart = (LPC_UART_TypeDef *)LPC_UART0; break;
+            case p13   : _uart = (LPC_UART_TypeDef *)LPC_UART1; break;
+            case p28   : _uart = LPC_UART2; break;
+            case p9    : _uart = LPC_UART3; break;
+            default    : error("TFT_4DGL: no UART transmits on this pin\n");
+        }
+#endif
+    }
+
+    void baud(int speed)                  { flush(); _serial.baud(speed); }
+    void write(const char *data, int n)   { for (int i = 0; i < n; i++) _serial.putc(data[i]); }
+#if defined(TARGET_LPC1768)
+    void flush()                          { while (!(_uart->LSR & 0x40)); }  // TEMT: FIFO and shift register empty
+#else
+    void flush()                          { }         // no portable way to see the shift register
+#endif
+    int  readable()                       { return _serial.readable(); }
+    int  getc()                           { return _serial.getc(); }
+    void reset(int level)                 { _rst = level; }
+    void wait_ms(int ms)                  { ::wait_ms(ms); }
+    int  read_ms()                        { return _clock.read_ms(); }
+
+protected :
+
+    Serial     _serial;
+    DigitalOut _rst;
+    Timer      _clock;
+#if defined(TARGET_LPC1768)
+    LPC_UART_TypeDef *_uart;
+#endif
+};
+#endif
+
+#if TFT_4DGL_DMA
+// Size of each of the two DMA transmit buffers
+#define DMA_BUFFER   512
+
+//**************************************************************************
+// UART transmit through a GPDMA channel. Bytes are copied into one of two
+// buffers; while one is being sent the other one fills, and the transfer
+// complete interrupt starts the next one. Receive still uses the Serial.
+class DmaTransport {
+
+public :
+
+    DmaTransport(PinName tx, PinName rx, PinName rst);
+
+    void baud(int speed);
+    void write(const char *data, int n);
+    void flush();
+    int  readable()                       { return _serial.readable(); }
+    int  getc()                           { return _serial.getc(); }
+    void reset(int level)                 { _rst = level; }
+    void wait_ms(int ms)                  { ::wait_ms(ms); }
+    int  read_ms()                        { return _clock.read_ms(); }
+
+    // Statistics
+    int transfers;                        // DMA transfers started
+
+protected :
+
+    void start();                         // send the filling buffer if the channel is idle
+    void kick();                          // same, with interrupts already off
+    static void isr();
+
+    Serial     _serial;
+    DigitalOut _rst;
+    Timer      _clock;
+
+    LPC_UART_TypeDef *_uart;
+    int               _request;           // GPDMA peripheral number of the UART transmit
+
+    char          _buffer[2][DMA_BUFFER];
+    volatile int  _length[2];
+    volatile int  _filling;               // buffer taking new bytes
+    volatile int  _sending;               // buffer on the DMA channel
+    volatile int  _busy;                  // a transfer is running
+
+    static DmaTransport *_active;
+};
+#endif
+
+#if TFT_4DGL_HOST
+// Bytes kept by MockTransport
+#define MOCK_BUFFER  4096
+
+//**************************************************************************
+// Host mock : records everything written and answers from a scripted queue.
+// With auto_ack set, every write ending a command is answered with an ACK.
+class MockTransport {
+
+public :
+
+    MockTransport(PinName, PinName, PinName) {
+        sent_count = 0;
+        auto_ack   = 1;
+        speed      = 9600;
+        level      = 1;
+        _now       = 0;
+        _rx_head   = 0;
+        _rx_tail   = 0;
+    }
+
+    void baud(int s)                      { speed = s; }
+    void write(const char *data, int n) {
+        for (int i = 0; i < n; i++)
+            if (sent_count < MOCK_BUFFER) sent[sent_count++] = data[i];
+        if (auto_ack) respond("\x06", 1);
+    }
+    void flush()                          { }
+    int  readable()                       { return _rx_head != _rx_tail; }
+    int  getc() {
+        if (_rx_head == _rx_tail) return -1;
+        unsigned char c = _rx[_rx_tail];
+        _rx_tail = (_rx_tail + 1) % MOCK_BUFFER;
+        return c;
+    }
+    void reset(int l)                     { level = l; }
+    void wait_ms(int ms)                  { _now += ms; }
+    int  read_ms()                        { return _now++; }  // time moves on while polling
+
+    // Queue answer bytes for the driver
+    void respond(const char *data, int n) {
+        for (int i = 0; i < n; i++) {
+            _rx[_rx_head] = data[i];
+            _rx_head = (_rx_head + 1) % MOCK_BUFFER;
+        }
+    }
+
+    char sent[MOCK_BUFFER];               // bytes written by the driver
+    int  sent_count;
+    int  auto_ack;
+    int  speed;
+    int  level;                           // reset line
+
+protected :
+
+    int  _now;
+    char _rx[MOCK_BUFFER];
+    int  _rx_head;
+    int  _rx_tail;
+};
+#endif
+
+#if TFT_4DGL_HOST
+// Size of the simulated screen, in pixels
+#define SIM_WIDTH    640
+#define SIM_HEIGHT   480
+// Time the simulated screen takes to start after reset, in ms
+#define SIM_BOOT_MS  500
+
+//**************************************************************************
+// Host simulator of a 4DGL screen. Commands are decoded and drawn into a
+// RGB565 frame buffer, answers are produced like the real module, and time
+// advances with the bytes sent at the current baud rate.
+// The frame buffer is large, so create the driver as a static object.
+class SimTransport {
+
+public :
+
+    SimTransport(PinName tx, PinName rx, PinName rst);
+
+    void baud(int s)                      { speed = s; }
+    void write(const char *data, int n);
+    void flush()                          { }
+    int  readable()                       { return _rx_head != _rx_tail; }
+    int  getc();
+    void reset(int level);
+    void wait_ms(int ms)                  { _us += ms * 1000; }
+    int  read_ms()                        { _us += 100; return _us / 1000; }
+
+    // Simulated screen contents
+    unsigned short frame[SIM_HEIGHT][SIM_WIDTH];
+
+    // Statistics
+    int commands;                         // commands executed
+    int bytes;                            // bytes received
+    int errors;                           // unknown opcodes, answered with NAK
+    int speed;                            // link speed
+
+protected :
+
+    int  length();                        // full length of the command being received, 0 if not known yet
+    void execute();
+    void answer(char c);
+
+    void fill(int x1, int y1, int x2, int y2, unsigned short c);
+    void plot(int x, int y, unsigned short c);
+    void image(unsigned char c);          // one byte of display image pixels
+    void line(int x1, int y1, int x2, int y2, unsigned short c);
+
+    int  word(int i)                      { return ((unsigned char)_in[i] << 8) | (unsigned char)_in[i + 1]; }
+
+    long _us;                             // simulated time
+    long _ready_us;                       // end of the boot after a reset
+    int  _level;                          // reset line
+
+    unsigned short _background;
+    char _pen;
+
+    char _in[1100];                       // command being received
+    int  _count;
+
+    int  _image_left;                     // display image bytes still to come
+    int  _image_x, _image_y, _image_w;
+    int  _image_pos;                      // pixels drawn
+    char _image_mode;
+    int  _image_high;                     // first byte of a 16 bits pixel, -1 if none
+
+    char _rx[64];
+    int  _rx_head;
+    int  _rx_tail;
+};
+#endif
+
+// Direction flag of a recorded byte
+#define RECORD_RX      0x100
+// Entries kept by RecordTransport
+#define RECORD_BUFFER  4096
+
+//**************************************************************************
+// Recording tap around another transport. Every byte sent and received is
+// logged in order, so a session can be checked or replayed later.
+template <class Inner>
+class RecordTransport {
+
+public :
+
+    RecordTransport(PinName tx, PinName rx, PinName rst) : link(tx, rx, rst) {
+        count    = 0;
+        overflow = 0;
+    }
+
+    void baud(int speed)                  { link.baud(speed); }
+    void write(const char *data, int n) {
+        for (int i = 0; i < n; i++) log_byte((unsigned char)data[i]);
+        link.write(data, n);
+    }
+    void flush()                          { link.flush(); }
+    int  readable()                       { return link.readable(); }
+    int  getc() {
+        int c = link.getc();
+        log_byte(RECORD_RX | (c & 0xFF));
+        return c;
+    }
+    void reset(int level)                 { link.reset(level); }
+    void wait_ms(int ms)                  { link.wait_ms(ms); }
+    int  read_ms()                        { return link.read_ms(); }
+
+    Inner          link;                  // the transport being recorded
+    unsigned short log[RECORD_BUFFER];    // bytes sent, and received with RECORD_RX set
+    int            count;
+    int            overflow;              // entries that did not fit
+
+protected :
+
+    void log_byte(unsigned short entry) {
+        if (count < RECORD_BUFFER) log[count++] = entry;
+        else overflow++;
+    }
+};
+
+//**************************************************************************
+// Plays a RecordTransport log back : answers come from the log, and the
+// bytes the driver sends are checked against the recorded ones. Past the
+// end of the log every write is answered with an ACK so the driver never
+// stalls, and counted as a mismatch.
+class ReplayTransport {
+
+public :
+
+    ReplayTransport(PinName, PinName, PinName) {
+        load(0, 0);
+        _now = 0;
+    }
+
+    void load(const unsigned short *log, int count) {
+        _log       = log;
+        _count     = count;
+        _pos       = 0;
+        _acks      = 0;
+        mismatches = 0;
+    }
+
+    void baud(int)                        { }
+    void write(const char *data, int n) {
+        for (int i = 0; i < n; i++) {
+            while (_pos < _count && (_log[_pos] & RECORD_RX)) _pos++;  // answers the driver never read
+            if (_pos >= _count || _log[_pos] != (unsigned char)data[i]) mismatches++;
+            if (_pos < _count) _pos++;
+            else _acks = 1;
+        }
+    }
+    void flush()                          { }
+    int  readable()                       { return (_pos < _count) ? (_log[_pos] & RECORD_RX) != 0 : _acks > 0; }
+    int  getc() {
+        if (_pos < _count && (_log[_pos] & RECORD_RX)) return _log[_pos++] & 0xFF;
+        if (_pos >= _count && _acks) {
+            _acks--;
+            return 0x06;                  // ACK
+        }
+        return -1;
+    }
+    void reset(int)                       { }
+    void wait_ms(int ms)                  { _now += ms; }
+    int  read_ms()                        { return _now++; }
+
+    int done()                            { return _pos >= _count; }
+
+    int mismatches;                       // bytes sent that differ from the recording
+
+protected :
+
+    const unsigned short *_log;
+    int _count;
+    int _pos;
+    int _acks;                            // answers owed past the end of the log
+    int _now;
+};
+
+// Transport used by TFT_4DGL
+#ifndef TFT_4DGL_TRANSPORT
+#if TFT_4DGL_HOST
+#define TFT_4DGL_TRANSPORT MockTransport
+#elif TFT_4DGL_DMA
+#define TFT_4DGL_TRANSPORT DmaTransport
+#else
+#define TFT_4DGL_TRANSPORT SerialTransport
+#endif
+#endif
+
+#endif
@@ -16,7 +16,6 @@
 // You should have received a copy of the GNU General Public License
 // along with TFT_4DGL.  If not, see <http://www.gnu.org/licenses/>.
 
-#include "mbed.h"
 #include "TFT_4DGL.h"
 
 #define ARRAY_SIZE(X) sizeof(X)/sizeof(X[0])
@@ -24,8 +23,24 @@
 //Serial pc(USBTX,USBRX);
 
 //******************************************************************************************************
-TFT_4DGL :: TFT_4DGL(PinName tx, PinName rx, PinName rst) : _cmd(tx, rx), 
-                                                            _rst(rst) 
+static int resolution(int code) {                 // pixels for a resolution code of the version answer, 0 if unknown
+
+    switch (code) {
+        case 0x22 : return 220;
+        case 0x24 : return 240;
+        case 0x28 : return 128;
+        case 0x32 : return 320;
+        case 0x60 : return 160;
+        case 0x64 : return 64;
+        case 0x76 : return 176;
+        case 0x96 : return 96;
+        default :   return 0;
+    }
+}
+
+//******************************************************************************************************
+template <class Transport>
+TFT_4DGL_Base<Transport> :: TFT_4DGL_Base(PinName tx, PinName rx, PinName rst, int speed) : _cmd(tx, rx, rst)
 #if DEBUGMODE
                                                             ,pc(USBTX, USBRX)
 #endif // DEBUGMODE
@@ -40,99 +55,512 @@ TFT_4DGL :: TFT_4DGL(PinName tx, PinName rx, PinName rst) : _cmd(tx, rx),
     pc.printf("********************\n");
 #endif
 
-    _rst = 1;    // put RESET pin to high to start TFT screen
-
-    reset();
-    autobaud();  // send autobaud command
-    version();   // get version information
-    cls();       // clear screen
+    _boot        = _cmd.read_ms();
+    batching     = 0;
+    pending_acks = 0;
+    acked        = 0;
+    ack_stalls   = 0;
+    state_skipped     = 0;
+    state_bytes_saved = 0;
+    reply_timeouts    = 0;
+    reply_errors      = 0;
+    late_replies      = 0;
+    retries           = 0;
+    resyncs           = 0;
+    resync_failures   = 0;
+    max_stall_ms      = 0;
+    culled            = 0;
+    clipped           = 0;
+    clip_x1           = 0;                // no clip rectangle, only the screen
+    clip_y1           = 0;
+    clip_x2           = 0x7FFF;
+    clip_y2           = 0x7FFF;
+    clip_depth        = 0;
+    reserved1         = 0;                // no resolution codes until version() answers
+    reserved2         = 0;
+    current_font      = FONT_5X7;
+    invalidate_state();
+
+    _cmd.reset(1);                      // put RESET pin to high to start TFT screen
+
+    reset();     // reset and wait for the autobaud answer
+    if (speed) baudrate(speed);         // go fast before anything else
+    boot_baud_ms = boot_elapsed_ms();
+
+    version();   // get version information, the screen size with it
 
     current_col         = 0;            // initial cursor col
     current_row         = 0;            // initial cursor row
     current_color       = WHITE;        // initial text color
-    current_orientation = IS_PORTRAIT;  // initial screen orientation
+    set_geometry(resolution(reserved1), resolution(reserved2));  // screen starts in its native orientation
 
+    batch_begin();
     set_font(FONT_5X7);                 // initial font
     text_mode(OPAQUE);                  // initial texr mode
+    batch_end();
+
+    cls();       // clear screen
+    boot_done_ms = boot_elapsed_ms();
+
+#if DEBUGMODE
+    pc.printf("Boot : %d probes, ready %d ms, baud %d ms, done %d ms\n",
+              boot_probes, boot_ready_ms, boot_baud_ms, boot_done_ms);
+#endif
+}
+
+//******************************************************************************************************
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: set_geometry(int width, int height) {
+
+    if (width <= 0 || height <= 0) {                    // size not reported, the default portrait screen
+        width  = DEFAULT_WIDTH;
+        height = DEFAULT_HEIGHT;
+    }
+    current_orientation = (width < height) ? IS_PORTRAIT : IS_LANDSCAPE;
+    geometry(width, height);
+}
+
+//******************************************************************************************************
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: geometry(int width, int height) { // work out the sizes of both orientations and every font
+
+    if (width <= 0 || height <= 0) {
+        width  = DEFAULT_WIDTH;
+        height = DEFAULT_HEIGHT;
+    }
+    int wide   = (width > height) ? width : height;
+    int narrow = (width > height) ? height : width;
+
+    orient_width[IS_LANDSCAPE]  = wide;
+    orient_height[IS_LANDSCAPE] = narrow;
+    orient_width[IS_PORTRAIT]   = narrow;
+    orient_height[IS_PORTRAIT]  = wide;
+
+    for (int o = 0; o < 2; o++) {
+        for (int f = 0; f < 4; f++) {
+            font_cols[o][f] = orient_width[o]  / font_cell_w[f];
+            font_rows[o][f] = orient_height[o] / font_cell_h[f];
+        }
+    }
+    orient();
 }
 
 //******************************************************************************************************
-void TFT_4DGL :: writeBYTE(char c) { // send a BYTE command to screen
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: orient(void) {   // take the sizes of the current orientation and font
 
-    _cmd.putc(c);
-    wait_ms(1);
+    screen_width  = orient_width[(int)current_orientation];
+    screen_height = orient_height[(int)current_orientation];
+    max_col       = font_cols[(int)current_orientation][current_font & 3];
+    max_row       = font_rows[(int)current_orientation][current_font & 3];
+}
+
+//******************************************************************************************************
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: viewport(int *x1, int *y1, int *x2, int *y2) { // area drawing may touch : clip rectangle within the screen
+
+    *x1 = (clip_x1 > 0) ? clip_x1 : 0;
+    *y1 = (clip_y1 > 0) ? clip_y1 : 0;
+    *x2 = (clip_x2 < screen_width)  ? clip_x2 : screen_width - 1;
+    *y2 = (clip_y2 < screen_height) ? clip_y2 : screen_height - 1;
+}
+
+//******************************************************************************************************
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: push_clip(int x1, int y1, int x2, int y2) {
+
+    if (clip_depth == CLIP_DEPTH) return 0;
+
+    clip_stack[clip_depth][0] = clip_x1;
+    clip_stack[clip_depth][1] = clip_y1;
+    clip_stack[clip_depth][2] = clip_x2;
+    clip_stack[clip_depth][3] = clip_y2;
+    clip_depth++;
+
+    if (x1 > x2) { int t = x1; x1 = x2; x2 = t; }
+    if (y1 > y2) { int t = y1; y1 = y2; y2 = t; }
+    if (x1 > clip_x1) clip_x1 = x1;                      // intersection with the current one
+    if (y1 > clip_y1) clip_y1 = y1;
+    if (x2 < clip_x2) clip_x2 = x2;
+    if (y2 < clip_y2) clip_y2 = y2;
+    return 1;
+}
+
+//******************************************************************************************************
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: pop_clip() {
+
+    if (clip_depth == 0) return;
+
+    clip_depth--;
+    clip_x1 = clip_stack[clip_depth][0];
+    clip_y1 = clip_stack[clip_depth][1];
+    clip_x2 = clip_stack[clip_depth][2];
+    clip_y2 = clip_stack[clip_depth][3];
+}
+
+//******************************************************************************************************
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: outside(int x1, int y1, int x2, int y2) { // 1 if the box misses the viewport, counted as culled
+
+    int vx1, vy1, vx2, vy2;
+
+    viewport(&vx1, &vy1, &vx2, &vy2);
+    if (x1 > x2) { int t = x1; x1 = x2; x2 = t; }
+    if (y1 > y2) { int t = y1; y1 = y2; y2 = t; }
+
+    if (x2 < vx1 || y2 < vy1 || x1 > vx2 || y1 > vy2) {
+        culled++;
+        return 1;
+    }
+    return 0;
+}
+
+//******************************************************************************************************
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: writeBYTE(char c) { // send a BYTE command to screen
+
+    writeBUFFER(&c, 1);
+}
+
+//******************************************************************************************************
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: writeBUFFER(char *command, int number) { // send a whole command in one burst
+
+    _cmd.write(command, number);
 
 #if DEBUGMODE
-    pc.printf("   Char sent : 0x%02X\n",c);
+    for (int i = 0; i < number; i++) pc.printf("   Char sent : 0x%02X\n", command[i]);
 #endif
 
 }
 
 //******************************************************************************************************
-void TFT_4DGL :: freeBUFFER(void) {       // Clear serial buffer before writing command
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: freeBUFFER(void) {        // Clear serial buffer before writing command, return bytes dropped
+
+    int count = 0;
 
-    while (_cmd.readable()) _cmd.getc();  // clear buffer garbage
+    while (_cmd.readable()) {             // clear buffer garbage
+        _cmd.getc();
+        count++;
+    }
+    return count;
 }
 
 //******************************************************************************************************
-int TFT_4DGL :: writeCOMMAND(char *command, int number) { // send several BYTES making a command and return an answer
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: writeCOMMAND(char *command, int number) { // send several BYTES making a command and return an answer
 
 #if DEBUGMODE
     pc.printf("\n");
     pc.printf("New COMMAND : 0x%02X\n", command[0]);
 #endif
-    int i, resp = 0;
-    freeBUFFER();
+    int resp = 0;
+    char response[1];
+
+    if (batching) {                                    // answer collected by poll_acks() or batch_end()
+        ackROOM();
+        writeBUFFER(command, number);
+        pending_acks++;
+        return 1;
+    }
 
-    for (i = 0; i < number; i++) writeBYTE(command[i]); // send command to serial port
+    if (transact(command, number, response) == 1) {
+        switch (response[0]) {
+            case ACK :                                 // if OK return   1
+                resp =  1;
+                break;
+            case NAK :                                 // if NOK return -1
+                resp = -1;
+                break;
+        }
+    }
+#if DEBUGMODE
+    pc.printf("   Answer received : %d\n",resp);
+#endif
 
-    while (!_cmd.readable()) wait_ms(TEMPO);              // wait for screen answer
-    if (_cmd.readable()) resp = _cmd.getc();           // read response if any
+    return resp;                                       // else return    0
+}
+
+//******************************************************************************************************
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: ackROOM(void) {       // make sure one more batched ACK fits the window
+
+    if (pending_acks >= ACK_WINDOW && poll_acks() >= ACK_WINDOW) {
+        ack_stalls++;                                  // receive FIFO nearly full, make room
+        if (readACK(REPLY_TIMEOUT) == 1) {
+            acked++;
+            pending_acks--;
+        } else {                                       // the ACKs are lost, start over from a clean link
+            invalidate_state();
+            resync(_cmd.read_ms() + RESYNC_LIMIT_MS);
+            pending_acks = 0;
+        }
+    }
+}
+
+//******************************************************************************************************
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: readACK(int timeout) { // wait at most timeout ms for an answer, 0 if none came
+
+    char resp = 0;
+
+    if (readREPLY(&resp, 1, _cmd.read_ms() + timeout) == 0) return 0;
     switch (resp) {
         case ACK :                                     // if OK return   1
-            resp =  1;
-            break;
+            return  1;
         case NAK :                                     // if NOK return -1
-            resp = -1;
-            break;
+            return -1;
+        default :
+            return  0;                                 // else return   0
+    }
+}
+
+//******************************************************************************************************
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: readREPLY(char *response, int number, int deadline) { // read number bytes unless the deadline passes first, return the count
+
+    int count = 0;
+
+    while (count < number) {
+        if (_cmd.readable()) response[count++] = (char)_cmd.getc();
+        else if (_cmd.read_ms() - deadline >= 0) break;
+    }
+    return count;
+}
+
+//******************************************************************************************************
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: replyLENGTH(char *command, int number) { // bytes the screen answers a command with
+
+    switch (command[0]) {
+        case VERSION :
+            return 5;                                  // type, revision, firmware, 2 reserved
+        case READPIXEL :
+            return 2;                                  // 16 bits color
+        case GETTOUCH :
+            if (number > 1 && (command[1] == STATUS || command[1] == GETPOSITION))
+                return 4;                              // status or x,y on 2 words
+            return 1;
         default :
-            resp =  0;                                 // else return   0
+            return 1;                                  // ACK or NAK
+    }
+}
+
+//******************************************************************************************************
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: replyTIMEOUT(char *command, int number) { // ms the screen may take to answer a command
+
+    switch (command[0]) {
+        case CLS :
+        case SCREENCOPY :
+        case DISPIMAGE :
+            return SLOW_REPLY_TIMEOUT;
+        case WAITTOUCH :                               // answered on touch or at the end of its delay
+            if (number >= 3)
+                return (((command[1] & 0xFF) << 8) | (command[2] & 0xFF)) + REPLY_TIMEOUT;
+            return REPLY_TIMEOUT;
+        default :
+            return REPLY_TIMEOUT;
+    }
+}
+
+//******************************************************************************************************
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: transact(char *command, int number, char *response) { // send a command and read its whole reply, return its length or 0
+
+    int expected = replyLENGTH(command, number);
+    int timeout  = replyTIMEOUT(command, number);
+    int start    = _cmd.read_ms();
+    int limit    = start + timeout + RESYNC_LIMIT_MS; // hard bound on the whole exchange
+    int count    = 0;
+
+    for (int attempt = 0; ; attempt++) {
+        if (freeBUFFER()) late_replies++;              // an earlier reply came after its deadline
+
+        writeBUFFER(command, number);                  // send all chars to serial port
+
+        int deadline = _cmd.read_ms() + timeout;
+        if (deadline - limit > 0) deadline = limit;
+        count = readREPLY(response, expected, deadline);
+
+        if (count == expected) {
+            if (expected > 1 || response[0] == ACK || response[0] == NAK) break;
+            reply_errors++;                            // framing slip, not an answer
+        } else {
+            reply_timeouts++;
+        }
+        count = 0;
+
+        invalidate_state();                            // the command may or may not have been done
+        if (!resync(limit)) break;
+        if (attempt >= REPLY_RETRIES || command[0] == WAITTOUCH) break;
+        retries++;
+    }
+
+    int stall = _cmd.read_ms() - start;
+    if (stall > max_stall_ms) max_stall_ms = stall;
+    return count;
+}
+
+//******************************************************************************************************
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: drain(int deadline) { // read and drop bytes until the link is quiet, return the count
+
+    int count = 0;
+    int quiet = _cmd.read_ms();
+
+    while (_cmd.read_ms() - quiet < RESYNC_QUIET && _cmd.read_ms() - deadline < 0) {
+        if (_cmd.readable()) {
+            _cmd.getc();
+            count++;
+            quiet = _cmd.read_ms();
+        }
+    }
+    return count;
+}
+
+//******************************************************************************************************
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: resync(int deadline) { // realign with the screen without a reset, 1 if done
+
+    char command[2] = { VERSION, OFF };                // harmless, and its 0 ends any string being received
+    char response[5];
+
+    resyncs++;
+    for (int probe = 0; probe < RESYNC_PROBES && _cmd.read_ms() - deadline < 0; probe++) {
+        drain(deadline);
+        writeBUFFER(command, 2);                       // completes whatever command the screen was still reading
+
+        int wait = _cmd.read_ms() + REPLY_TIMEOUT;
+        if (wait - deadline > 0) wait = deadline;
+        if (readREPLY(response, 5, wait) == 5 && drain(deadline) == 0) return 1;
+    }
+    resync_failures++;
+    return 0;
+}
+
+//******************************************************************************************************
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: batch_begin() {       // commands are now sent without waiting for their ACK
+
+    freeBUFFER();
+    batching     = 1;
+    pending_acks = 0;
+}
+
+//******************************************************************************************************
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: batch_end() {          // collect the ACKs of all batched commands
+
+    int count = 0;
+
+    batching = 0;
+    while (pending_acks > 0) {
+        if (readACK(REPLY_TIMEOUT) != 1) {            // lost or garbled, the rest cannot be trusted
+            reply_timeouts++;
+            invalidate_state();                       // a setting may not have been applied
+            resync(_cmd.read_ms() + RESYNC_LIMIT_MS);
+            pending_acks = 0;
             break;
+        }
+        count++;
+        pending_acks--;
     }
-#if DEBUGMODE
-    pc.printf("   Answer received : %d\n",resp);
-#endif
+    acked += count;
+    return count;
+}
 
-    return resp;
+//******************************************************************************************************
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: poll_acks() {          // collect the batch ACKs already received
+
+    while (pending_acks > 0 && _cmd.readable()) {
+        int resp = _cmd.getc();
+        if (resp == ACK) acked++;
+        else {
+            if (resp != NAK) reply_errors++;
+            invalidate_state();
+        }
+        pending_acks--;
+    }
+    return pending_acks;
 }
 
-//**************************************************************************
-void TFT_4DGL :: reset() {  // Reset Screen
+//******************************************************************************************************
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: boot_elapsed_ms() {
+
+    return (_cmd.read_ms() - _boot);
+}
 
-    _rst = 0;               // put RESET pin to low
-    wait_ms(TEMPO);         // wait a few milliseconds for command reception
-    _rst = 1;               // put RESET back to high
-    wait(3);                // wait 3s for screen to restart
+//**************************************************************************
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: reset() {  // Reset Screen
+
+    invalidate_state();     // the screen restarts with its own defaults
+    _cmd.reset(0);          // put RESET pin to low
+    _cmd.wait_ms(TEMPO);    // wait a few milliseconds for command reception
+    _cmd.reset(1);          // put RESET back to high
+
+    int start = _cmd.read_ms();     // poll until the screen answers instead of waiting 3s
+    boot_probes = 0;
+    while (_cmd.read_ms() - start < RESET_TIMEOUT) {
+        freeBUFFER();       // clean buffer from possible garbage
+        writeBYTE(AUTOBAUD);
+        boot_probes++;
+        if (readACK(PROBE_TIMEOUT) == 1) break;
+    }
+    boot_ready_ms = boot_elapsed_ms();
 
-    freeBUFFER();           // clean buffer from possible garbage
+    freeBUFFER();
 }
 
 //**************************************************************************
-void TFT_4DGL :: autobaud() { // send AutoBaud command (9600)
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: autobaud() { // send AutoBaud command (9600)
     char command[1] = "";
     command[0] = AUTOBAUD;
+    invalidate_state();     // reconnecting, the screen may have restarted
     writeCOMMAND(command, 1);
 }
 
 //**************************************************************************
-void TFT_4DGL :: cls() {  // clear screen
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: invalidate_state() {  // forget the settings sent to the screen
+
+    shadow_font       = SHADOW_UNKNOWN;
+    shadow_text_mode  = SHADOW_UNKNOWN;
+    shadow_pen        = SHADOW_UNKNOWN;
+    shadow_background = SHADOW_UNKNOWN;
+    for (int i = 0; i < SHADOW_CONTROLS; i++) shadow_control[i] = SHADOW_UNKNOWN;
+}
+
+//**************************************************************************
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: same_state(int *shadow, int value, int number) {  // 1 if the screen already has value, else remember it
+
+    if (*shadow == value) {
+        state_skipped++;
+        state_bytes_saved += number;
+        return 1;
+    }
+    *shadow = value;
+    return 0;
+}
+
+//**************************************************************************
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: cls() {  // clear screen
     char command[1] = "";
     command[0] = CLS;
     writeCOMMAND(command, 1);
 }
 
 //**************************************************************************
-void TFT_4DGL :: version() {  // get API version
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: version() {  // get API version
     char command[2] = "";
     command[0] = VERSION;
     command[1] = OFF;
@@ -140,7 +568,8 @@ void TFT_4DGL :: version() {  // get API version
 }
 
 //**************************************************************************
-void TFT_4DGL :: baudrate(int speed) {  // set screen baud rate
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: baudrate(int speed) {  // set screen baud rate
     char command[2]= "";
     command[0] = BAUDRATE;
     switch (speed) {
@@ -198,45 +627,25 @@ void TFT_4DGL :: baudrate(int speed) {  // set screen baud rate
             break;
     }
 
-    int i, resp = 0;
+    if (freeBUFFER()) late_replies++;
 
-    freeBUFFER();
-
-    for (i = 0; i <2; i++) writeBYTE(command[i]);      // send command to serial port
-    _cmd.baud(speed);                                  // set mbed to same speed
-
-    while (!_cmd.readable()) wait_ms(TEMPO);           // wait for screen answer
+    writeBUFFER(command, 2);                            // send command to serial port
+    _cmd.baud(speed);                                  // set mbed to same speed, once the command is out
 
-    if (_cmd.readable()) resp = _cmd.getc();           // read response if any
-    switch (resp) {
-        case ACK :                                     // if OK return   1
-            resp =  1;
-            break;
-        case NAK :                                     // if NOK return -1
-            resp = -1;
-            break;
-        default :
-            resp =  0;                                 // else return   0
-            break;
+    if (readACK(REPLY_TIMEOUT) != 1) {                 // answered at the new speed, realign if it got lost
+        reply_timeouts++;
+        resync(_cmd.read_ms() + RESYNC_LIMIT_MS);
     }
 }
 
 //******************************************************************************************************
-int TFT_4DGL :: readVERSION(char *command, int number) { // read screen info and populate data
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: readVERSION(char *command, int number) { // read screen info and populate data
 
-    int i, temp = 0, resp = 0;
+    int resp = 0;
     char response[5] = "";
 
-    freeBUFFER();
-
-    for (i = 0; i < number; i++) writeBYTE(command[i]);    // send all chars to serial port
-
-    while (!_cmd.readable()) wait_ms(TEMPO);               // wait for screen answer
-
-    while (_cmd.readable() && resp < ARRAY_SIZE(response)) {
-        temp = _cmd.getc();
-        response[resp++] = (char)temp;
-    }
+    resp = transact(command, number, response);            // send and read the 5 bytes answer
     switch (resp) {
         case 5 :                                           // if OK populate data and return 1
             type      = response[0];
@@ -254,7 +663,8 @@ int TFT_4DGL :: readVERSION(char *command, int number) { // read screen info and
 }
 
 //****************************************************************************************************
-void TFT_4DGL :: background_color(int color) {            // set screen background color
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: background_color(int color) {            // set screen background color
     char command[3]= "";                                  // input color is in 24bits like 0xRRGGBB
 
     command[0] = BCKGDCOLOR;
@@ -266,11 +676,13 @@ void TFT_4DGL :: background_color(int color) {            // set screen backgrou
     command[1] = ((red5 << 3)   + (green6 >> 3)) & 0xFF;  // first part of 16 bits color
     command[2] = ((green6 << 5) + (blue5 >>  0)) & 0xFF;  // second part of 16 bits color
 
-    writeCOMMAND(command, 3);
+    if (same_state(&shadow_background, ((command[1] & 0xFF) << 8) | (command[2] & 0xFF), 3)) return;
+    if (writeCOMMAND(command, 3) != 1) shadow_background = SHADOW_UNKNOWN;
 }
 
 //****************************************************************************************************
-void TFT_4DGL :: display_control(char mode, char value) {   // set screen mode to value
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: display_control(char mode, char value) {   // set screen mode to value
     char command[3]= "";
 
     command[0] = DISPCONTROL;
@@ -293,12 +705,30 @@ void TFT_4DGL :: display_control(char mode, char value) {   // set screen mode t
                 break;
         }
     }
-    writeCOMMAND(command, 3);
+    int *shadow = ((unsigned char)mode < SHADOW_CONTROLS) ? &shadow_control[(unsigned char)mode] : 0;
+    if (shadow && same_state(shadow, value & 0xFF, 3)) return;
+    if (writeCOMMAND(command, 3) != 1 && shadow) *shadow = SHADOW_UNKNOWN;
+    if (mode == ORIENTATION) shadow_font = SHADOW_UNKNOWN;     // font is sent again for the new orientation
+    if (mode == RESOLUTION) {
+        switch (value) {
+            case RES_320X240 :
+                set_geometry(320, 240);
+                break;
+            case RES_640X480 :
+                set_geometry(640, 480);
+                break;
+            case RES_800X480 :
+                set_geometry(800, 480);
+                break;
+        }
+    }
+    orient();
     set_font(current_font);
 }
 
 //****************************************************************************************************
-void TFT_4DGL :: set_volume(char value) {   // set sound volume to value
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: set_volume(char value) {   // set sound volume to value
     char command[2]= "";
 
     command[0] = SETVOLUME;
@@ -309,25 +739,17 @@ void TFT_4DGL :: set_volume(char value) {   // set sound volume to value
 
 
 //******************************************************************************************************
-void TFT_4DGL :: getTOUCH(char *command, int number, int *x, int *y) { // read screen info and populate data
+template <class Transport>
+void TFT_4DGL_Base<Transport> :: getTOUCH(char *command, int number, int *x, int *y) { // read screen info and populate data
 
 #if DEBUGMODE
     pc.printf("\n");
     pc.printf("New COMMAND : 0x%02X\n", command[0]);
 #endif
-    int i, temp = 0, resp = 0;
+    int resp = 0;
     char response[5] = "";
 
-    freeBUFFER();
-
-    for (i = 0; i < number; i++) writeBYTE(command[i]);    // send all chars to serial port
-
-    while (!_cmd.readable()) wait_ms(TEMPO);               // wait for screen answer
-
-    while (_cmd.readable() && resp < ARRAY_SIZE(response)) {
-        temp = _cmd.getc();
-        response[resp++] = (char)temp;
-    }
+    resp = transact(command, number, response);            // send and read the 4 bytes answer
 
 #if DEBUGMODE
     pc.printf("   Answer received %d : 0x%02X 0x%02X 0x%02X 0x%02X\n", resp, response[0], response[1], response[2], response[3]);
@@ -335,8 +757,8 @@ void TFT_4DGL :: getTOUCH(char *command, int number, int *x, int *y) { // read s
 
     switch (resp) {
         case 4 :                                                              // if OK populate data
-            *x = ((response[0]<<8)+ response[1]) * (response[0] != 0xFF);
-            *y = ((response[2]<<8)+ response[3]) * (response[2] != 0xFF);
+            *x = (((response[0] & 0xFF) << 8) + (response[1] & 0xFF)) * ((response[0] & 0xFF) != 0xFF);
+            *y = (((response[2] & 0xFF) << 8) + (response[3] & 0xFF)) * ((response[2] & 0xFF) != 0xFF);
             break;
         default :
             *x = -1;
@@ -350,26 +772,18 @@ void TFT_4DGL :: getTOUCH(char *command, int number, int *x, int *y) { // read s
 }
 
 //******************************************************************************************************
-int TFT_4DGL :: getSTATUS(char *command, int number) { // read screen info and populate data
+template <class Transport>
+int TFT_4DGL_Base<Transport> :: getSTATUS(char *command, int number) { // read screen info and populate data
 
 #if DEBUGMODE
     pc.printf("\n");
     pc.printf("New COMMAND : 0x%02X\n", command[0]);
 #endif
 
-    int i, temp = 0, resp = 0;
+    int resp = 0;
     char response[5] = "";
 
-    freeBUFFER();
-
-    for (i = 0; i < number; i++) writeBYTE(command[i]);    // send all chars to serial port
-
-    while (!_cmd.readable()) wait_ms(TEMPO);    // wait for screen answer
-
-    while (_cmd.readable() && resp < ARRAY_SIZE(response)) {
-        temp = _cmd.getc();
-        response[resp++] = (char)temp;
-    }
+    resp = transact(command, number, response);            // send and read the 4 bytes answer
     switch (resp) {
         case 4 :
             resp = (int)response[1];         // if OK populate data
@@ -384,4 +798,6 @@ int TFT_4DGL :: getSTATUS(char *command, int number) { // read screen info and p
 #endif
 
     return resp;
-}
\ No newline at end of file
+}
+
+#include "TFT_4DGL_Instances.h"
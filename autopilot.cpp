@@ -0,0 +1,349 @@
+#include "string.h"
+#include "autopilot.h"
+
+Autopilot::Autopilot()
+{
+    rebuilds = 0;
+    overflows = 0;
+    unsafe = 0;
+    lastCells = 0;
+    maxCells = 0;
+    head = 0;
+    tail = 0;
+    cells = 0;
+    foodx = -1;
+    foody = -1;
+    memset(dist, 0xFF, sizeof(dist));
+}
+
+void Autopilot::reset(const Game &game)
+{
+    cells = 0;
+    rebuild(game);
+    lastCells = cells;
+}
+
+bool Autopilot::isFree(const Game &game, int x, int y) const
+{
+    return x >= FIELD_MIN_X && x <= FIELD_MAX_X && y >= FIELD_MIN_Y && y <= FIELD_MAX_Y &&
+           !game.occupied(x, y);
+}
+
+bool Autopilot::push(int x, int y)
+{
+    if (tail - head == AUTOPILOT_QUEUE)
+        return false;
+    queue[tail++ & (AUTOPILOT_QUEUE - 1)] = y * FIELD_W + x;
+    return true;
+}
+
+void Autopilot::pop(int *x, int *y)
+{
+    int c = queue[head++ & (AUTOPILOT_QUEUE - 1)];
+    *x = c % FIELD_W;
+    *y = c / FIELD_W;
+    cells++;
+}
+
+// Breadth first from the apple over the free cells
+void Autopilot::rebuild(const Game &game)
+{
+    rebuilds++;
+    memset(dist, 0xFF, sizeof(dist));
+    head = 0;
+    tail = 0;
+    foodx = game.foodx;
+    foody = game.foody;
+    if (foodx < 0)
+        return;
+
+    dist[foody][foodx] = 0;
+    push(foodx, foody);
+    while (head != tail) {
+        int x, y;
+        pop(&x, &y);
+        for (int d = 0; d < 4; d++) {
+            int nx = x + dir_dx[d], ny = y + dir_dy[d];
+            if (dist[ny][nx] == AUTOPILOT_FAR && isFree(game, nx, ny)) {
+                dist[ny][nx] = dist[y][x] + 1;
+                //only the frontier is queued, it cannot outgrow the queue on this field
+                push(nx, ny);
+            }
+        }
+    }
+}
+
+// A cell taken by a head: the cells one further from the apple that have no
+// other neighbour one nearer lose their distance, and so on outwards. The
+// wave goes one distance at a time, so a neighbour is final when looked at.
+// The cells looked at stay in the queue for update(); false when more than
+// limit are, a full search is cheaper then.
+bool Autopilot::orphan(const Game &game, int x, int y, int limit)
+{
+    int first = tail;
+    int old = dist[y][x];
+    dist[y][x] = AUTOPILOT_FAR;
+
+    for (int d = 0; d < 4; d++) {
+        int nx = x + dir_dx[d], ny = y + dir_dy[d];
+        if (dist[ny][nx] == old + 1 && !marked(nx, ny) && isFree(game, nx, ny)) {
+            mark(nx, ny);
+            if (!push(nx, ny) || tail > limit)
+                return false;
+        }
+    }
+
+    while (head != tail) {
+        int cx, cy;
+        pop(&cx, &cy);
+        int cd = dist[cy][cx];
+        if (cd == AUTOPILOT_FAR)
+            continue;
+
+        bool held = false;
+        for (int d = 0; d < 4 && !held; d++) {
+            int nx = cx + dir_dx[d], ny = cy + dir_dy[d];
+            held = dist[ny][nx] == cd - 1 && isFree(game, nx, ny);
+        }
+        if (held)
+            continue;
+
+        dist[cy][cx] = AUTOPILOT_FAR;
+        for (int d = 0; d < 4; d++) {
+            int nx = cx + dir_dx[d], ny = cy + dir_dy[d];
+            if (dist[ny][nx] == cd + 1 && !marked(nx, ny) && isFree(game, nx, ny)) {
+                mark(nx, ny);
+                if (!push(nx, ny) || tail > limit)
+                    return false;
+            }
+        }
+    }
+
+    //another head's wave may have to look at these cells again
+    for (int i = first; i < tail; i++) {
+        int c = queue[i];
+        seen[c >> 5] &= ~(1u << (c & 31));
+    }
+    return true;
+}
+
+// Heap sort of the first count queue entries, nearest the apple first
+void Autopilot::order(int count)
+{
+    for (int n = count / 2 - 1; n >= 0; n--)
+        sift(n, count);
+    for (int end = count - 1; end > 0; end--) {
+        unsigned short t = queue[0];
+        queue[0] = queue[end];
+        queue[end] = t;
+        sift(0, end);
+    }
+}
+
+void Autopilot::sift(int n, int count)
+{
+    for (;;) {
+        int child = 2 * n + 1;
+        if (child >= count)
+            return;
+        if (child + 1 < count && at(queue[child + 1]) > at(queue[child]))
+            child++;
+        if (at(queue[n]) >= at(queue[child]))
+            return;
+        unsigned short t = queue[n];
+        queue[n] = queue[child];
+        queue[child] = t;
+        n = child;
+    }
+}
+
+// Distance of a cell from its neighbours
+int Autopilot::relaxed(const Game &game, int x, int y) const
+{
+    int best = AUTOPILOT_FAR;
+    for (int d = 0; d < 4; d++) {
+        int nx = x + dir_dx[d], ny = y + dir_dy[d];
+        if (dist[ny][nx] < best && isFree(game, nx, ny))
+            best = dist[ny][nx];
+    }
+    return (best == AUTOPILOT_FAR) ? best : best + 1;
+}
+
+void Autopilot::update(const Game &game)
+{
+    cells = 0;
+    if (game.foodx != foodx || game.foody != foody) {
+        rebuild(game);
+        lastCells = cells;
+        if (cells > maxCells)
+            maxCells = cells;
+        return;
+    }
+
+    //the new heads, one wave each; a dead snake did not move
+    head = 0;
+    tail = 0;
+    memset(seen, 0, sizeof(seen));
+    //past a quarter of the free cells rebuilding costs less; the tails' cells join
+    //the orphans in the queue
+    int limit = game.freeCells() / 4;
+    if (limit > AUTOPILOT_QUEUE - GAME_MAX_SNAKES)
+        limit = AUTOPILOT_QUEUE - GAME_MAX_SNAKES;
+    bool fits = true;
+    for (int i = 0; i < game.players && fits; i++) {
+        const Snake &s = game.snakes[i];
+        bool moved = s.tailx >= 0 || (s.events & GAME_ATE);
+        int x = s.body.headX(), y = s.body.headY();
+        if (moved && dist[y][x] != AUTOPILOT_FAR)
+            fits = orphan(game, x, y, limit);
+    }
+
+    //the orphans, once each, and the cells the tails left are the seeds,
+    //with the distance their neighbours give them
+    int count = 0;
+    if (fits) {
+        memset(seen, 0, sizeof(seen));
+        int looked = tail;
+        for (int i = 0; i < looked; i++) {
+            int c = queue[i];
+            int x = c % FIELD_W, y = c / FIELD_W;
+            if (dist[y][x] == AUTOPILOT_FAR && !marked(x, y) && isFree(game, x, y)) {
+                mark(x, y);
+                queue[count++] = c;
+            }
+        }
+        for (int i = 0; i < count; i++) {
+            int c = queue[i];
+            dist[c / FIELD_W][c % FIELD_W] = relaxed(game, c % FIELD_W, c / FIELD_W);
+        }
+        for (int i = 0; i < game.players && fits; i++) {
+            const Snake &s = game.snakes[i];
+            if (s.tailx < 0 || !isFree(game, s.tailx, s.taily))
+                continue;
+            dist[s.taily][s.tailx] = relaxed(game, s.tailx, s.taily);
+            queue[count++] = s.taily * FIELD_W + s.tailx;
+        }
+        order(count);
+    }
+
+    //relax outwards from the nearest seed: the next cell is the nearer of
+    //the next seed and the next cell that got nearer, so few are seen twice.
+    //A cell is relaxed again whenever it gets nearer.
+    int next = 0;
+    head = count;
+    tail = count;
+    while (fits && (next < count || head != tail)) {
+        int c;
+        if (head == tail || (next < count && at(queue[next]) <= at(queue[head & (AUTOPILOT_QUEUE - 1)])))
+            c = queue[next++];
+        else
+            c = queue[head++ & (AUTOPILOT_QUEUE - 1)];
+        cells++;
+
+        int x = c % FIELD_W, y = c / FIELD_W;
+        int d0 = dist[y][x];
+        if (d0 == AUTOPILOT_FAR)
+            continue;
+        for (int d = 0; d < 4 && fits; d++) {
+            int nx = x + dir_dx[d], ny = y + dir_dy[d];
+            if (dist[ny][nx] > d0 + 1 && isFree(game, nx, ny)) {
+                dist[ny][nx] = d0 + 1;
+                //seeds not taken yet stay put until the ring comes round to them
+                int oldest = (next < count) ? next : head;
+                fits = tail - oldest < AUTOPILOT_QUEUE;
+                if (fits)
+                    queue[tail++ & (AUTOPILOT_QUEUE - 1)] = ny * FIELD_W + nx;
+            }
+        }
+    }
+
+    if (!fits) {
+        overflows++;
+        rebuild(game);
+    }
+    lastCells = cells;
+    if (cells > maxCells)
+        maxCells = cells;
+}
+
+// Cells reachable from (x,y) once the head is there, up to limit. Reaching
+// the snake's own tail counts as limit: it keeps leaving room behind it.
+int Autopilot::room(const Game &game, int player, int x, int y, int limit)
+{
+    const Snake &s = game.snakes[player];
+    int tx = s.body.tailX(), ty = s.body.tailY();
+
+    memset(seen, 0, sizeof(seen));
+    head = 0;
+    tail = 0;
+    mark(x, y);
+    push(x, y);
+
+    int found = 0;
+    while (head != tail) {
+        int cx, cy;
+        pop(&cx, &cy);
+        if (++found >= limit)
+            return limit;
+        for (int d = 0; d < 4; d++) {
+            int nx = cx + dir_dx[d], ny = cy + dir_dy[d];
+            if (nx == tx && ny == ty)
+                return limit;
+            if (!marked(nx, ny) && isFree(game, nx, ny)) {
+                mark(nx, ny);
+                if (!push(nx, ny))
+                    return limit;       //a frontier that wide has room
+            }
+        }
+    }
+    return found;
+}
+
+int Autopilot::choose(const Game &game, int player)
+{
+    const Snake &s = game.snakes[player];
+    if (!s.alive)
+        return s.heading;
+
+    //the moves into a free cell, or the own tail which leaves this tick
+    //unless the apple is eaten, nearest the apple first
+    int moves[3], near[3], count = 0;
+    int hx = s.body.headX(), hy = s.body.headY();
+    int tx = s.body.tailX(), ty = s.body.tailY();
+    for (int h = 0; h < 4; h++) {
+        if (h == (s.heading ^ 2))
+            continue;
+        int x = hx + dir_dx[h], y = hy + dir_dy[h];
+        bool intoTail = x == tx && y == ty && !(x == game.foodx && y == game.foody);
+        if (!isFree(game, x, y) && !intoTail)
+            continue;
+        int n = count++;
+        for (; n > 0 && near[n - 1] > dist[y][x]; n--) {
+            moves[n] = moves[n - 1];
+            near[n] = near[n - 1];
+        }
+        moves[n] = h;
+        near[n] = dist[y][x];
+    }
+
+    //the nearest safe move, else the one with the most room
+    int pick = -1, most = -1;
+    int length = s.body.length();
+    for (int n = 0; n < count && most < length; n++) {
+        int x = hx + dir_dx[moves[n]], y = hy + dir_dy[moves[n]];
+        int r = (x == tx && y == ty) ? length : room(game, player, x, y, length);
+        if (r > most) {
+            most = r;
+            pick = moves[n];
+        }
+    }
+    if (most < length)
+        unsafe++;
+    if (pick < 0)
+        pick = s.heading;
+
+    lastCells = cells;
+    if (cells > maxCells)
+        maxCells = cells;
+    return pick;
+}
@@ -0,0 +1,84 @@
+#ifndef AUTOPILOT_H
+#define AUTOPILOT_H
+
+#include "game.h"
+#include "field.h"
+
+// Cells the search queue holds at once. A full search only keeps its
+// frontier there; an update that needs more rebuilds the distances.
+#define AUTOPILOT_QUEUE     2048
+// Distance of a cell the apple cannot be reached from
+#define AUTOPILOT_FAR       0xFFFF
+
+// Steers snakes towards the apple for attract screens and soak tests.
+//
+// It keeps the shortest path distance of every free cell to the apple,
+// over the game's occupancy grid, and a snake moves to its neighbour with
+// the smallest one. The distances are searched again in full only when the
+// apple moves. After other ticks update() repairs them from what the tick
+// changed: a new head orphans the cells whose shortest path went through
+// it, and those and the cells tails left are relaxed from their
+// neighbours, so the work follows the change rather than the field size.
+//
+// Before a move is taken, a flood fill from the cell checks that the
+// snake can still reach its tail from there, or has at least its length
+// of room. A move that fails is passed over for a safe one.
+//
+// The queue and bitset are allocated once, with the distances, in the
+// object; nothing is allocated while playing.
+class Autopilot
+{
+public:
+    Autopilot();
+
+    // Search the distances for a new game
+    void reset(const Game &game);
+
+    // Repair the distances after Game::tick()
+    void update(const Game &game);
+
+    // Heading for a snake's next tick
+    int choose(const Game &game, int player);
+
+    int distance(int x, int y) const { return dist[y][x]; }
+
+    // Statistics, in cells taken off the queue
+    int rebuilds;       // full searches
+    int overflows;      // of those, for an update that would have cost more
+    int unsafe;         // moves chosen without a safe one
+    int lastCells;      // by the last update() and choose()
+    int maxCells;
+
+private:
+    bool isFree(const Game &game, int x, int y) const;
+    void rebuild(const Game &game);
+    bool orphan(const Game &game, int x, int y, int limit);
+    int relaxed(const Game &game, int x, int y) const;
+    void order(int count);
+    void sift(int n, int count);
+    int room(const Game &game, int player, int x, int y, int limit);
+
+    bool push(int x, int y);
+    void pop(int *x, int *y);
+
+    // distance of a queued cell
+    int at(int c) const { return (&dist[0][0])[c]; }
+
+    void mark(int x, int y) { seen[(y * FIELD_W + x) >> 5] |= 1u << ((y * FIELD_W + x) & 31); }
+    bool marked(int x, int y) const { return (seen[(y * FIELD_W + x) >> 5] >> ((y * FIELD_W + x) & 31)) & 1; }
+
+    unsigned short dist[FIELD_H][FIELD_W];
+    unsigned int seen[(FIELD_W * FIELD_H + 31) / 32];
+
+    // ring of cells, y * FIELD_W + x
+    unsigned short queue[AUTOPILOT_QUEUE];
+    int head;
+    int tail;
+    int pushed;         // since the last clear, past AUTOPILOT_QUEUE means lost
+    int cells;          // taken off this update or choose
+
+    int foodx;
+    int foody;
+};
+
+#endif
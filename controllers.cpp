@@ -0,0 +1,173 @@
+#include <new>
+#include "controllers.h"
+
+// Addresses probed by scan(), player order
+static const Mpr121::Address addresses[MAX_PLAYERS] = {
+    Mpr121::ADD_VSS, Mpr121::ADD_VDD, Mpr121::ADD_SCL, Mpr121::ADD_SDA
+};
+
+ControllerManager::ControllerManager(I2cQueue *bus)
+{
+    this->bus = bus;
+    count = 0;
+    changed = 0;
+    turn = 0;
+    refresh = 0;
+    refreshed = false;
+    electrodeData = false;
+
+    for (int i = 0; i < MAX_PLAYERS; i++) {
+        chips[i] = 0;
+        slots[i].owner = this;
+        slots[i].player = i;
+        last[i] = -1;
+        busy[i] = false;
+        heads[i] = 0;
+        tails[i] = 0;
+    }
+
+    reads = 0;
+    irqReads = 0;
+    deferred = 0;
+    dropped = 0;
+    failed = 0;
+    spentUs = 0;
+}
+
+int ControllerManager::attach(Mpr121 *chip)
+{
+    if (count == MAX_PLAYERS)
+        return -1;
+    chips[count] = chip;
+    changed |= 1 << count;
+    return count++;
+}
+
+int ControllerManager::scan()
+{
+    for (int a = 0; a < MAX_PLAYERS && count < MAX_PLAYERS; a++) {
+        bool used = false;
+        for (int i = 0; i < count; i++)
+            if (chips[i]->getAddress() == addresses[a])
+                used = true;
+        if (used)
+            continue;
+
+        //anything that acknowledges a register read is taken as a chip
+        unsigned char probe;
+        if (bus->readSync(addresses[a], AFE_CFG, &probe, 1) != I2C_OK)
+            continue;
+
+        attach(new (storage[count]) Mpr121(bus, addresses[a]));
+    }
+    return count;
+}
+
+void ControllerManager::irq()
+{
+    changed = (1 << count) - 1;
+}
+
+void ControllerManager::frame()
+{
+    spentUs = 0;
+    refreshed = false;
+}
+
+// Expected bus time of a status read
+int ControllerManager::cost()
+{
+    int bytes = electrodeData ? ELECTRODE_READ : 2;
+    if (bus->averageUs() && !electrodeData)
+        return bus->averageUs();
+    //start, address, register, restart, address, data bytes, stop
+    return (30 + 9 * bytes) * 1000000 / bus->frequency();
+}
+
+bool ControllerManager::start(int player)
+{
+    if (busy[player])
+        return false;
+    busy[player] = true;
+    int bytes = electrodeData ? ELECTRODE_READ : 2;
+    if (!bus->read(chips[player]->getAddress(), 0x00, status[player], bytes, readDone, &slots[player])) {
+        busy[player] = false;
+        return false;
+    }
+    reads++;
+    spentUs += cost();
+    return true;
+}
+
+void ControllerManager::poll()
+{
+    //flagged chips first, round-robin so no player is always served last
+    for (int n = 0; n < count; n++) {
+        int p = (turn + n) % count;
+        if (!(changed & (1 << p)) || busy[p])
+            continue;
+        if (spentUs + cost() > I2C_FRAME_BUDGET_US) {
+            deferred++;
+            continue;
+        }
+        if (start(p)) {
+            changed &= ~(1 << p);
+            irqReads++;
+            turn = (p + 1) % count;
+        }
+    }
+
+    //then one background read per frame, in case an IRQ edge was missed
+    if (count && !refreshed && spentUs + cost() <= I2C_FRAME_BUDGET_US) {
+        if (start(refresh)) {
+            refresh = (refresh + 1) % count;
+            refreshed = true;
+        }
+    }
+}
+
+// I2C interrupt: queue the status if it changed
+void ControllerManager::readDone(void *ctx, int result)
+{
+    Slot *slot = (Slot *)ctx;
+    ControllerManager *m = slot->owner;
+    int p = slot->player;
+
+    m->busy[p] = false;
+    if (result != I2C_OK) {
+        m->failed++;
+        m->changed |= 1 << p;
+        return;
+    }
+
+    const unsigned char *r = m->status[p];
+    int s = r[0] | ((r[1] & 0x1F) << 8);
+    if (m->electrodeData) {
+        //filtered data is 10 bits from 0x04, baseline its top 8 bits from 0x1E
+        for (int e = 0; e < 12; e++) {
+            int filtered = r[0x04 + 2 * e] | ((r[0x05 + 2 * e] & 0x03) << 8);
+            if ((r[0x1E + e] << 2) - filtered >= EARLY_TOUCH_DELTA)
+                s |= 1 << (16 + e);
+        }
+    }
+    if (s == m->last[p])
+        return;
+
+    int h = m->heads[p];
+    if (((h + 1) & (INPUT_QUEUE - 1)) == m->tails[p]) {
+        m->dropped++;
+        return;
+    }
+    m->queue[p][h] = s;
+    m->heads[p] = (h + 1) & (INPUT_QUEUE - 1);
+    m->last[p] = s;
+}
+
+int ControllerManager::next(int player)
+{
+    if (player >= count || tails[player] == heads[player])
+        return -1;
+    int s = queue[player][tails[player]];
+    tails[player] = (tails[player] + 1) & (INPUT_QUEUE - 1);
+    return s;
+}
@@ -0,0 +1,107 @@
+#ifndef CONTROLLERS_H
+#define CONTROLLERS_H
+
+#include "i2cqueue.h"
+#include "mpr121.h"
+
+// One MPR121 per player, at most one per address
+#define MAX_PLAYERS         4
+// Touch status changes kept per player, a power of two
+#define INPUT_QUEUE         8
+// I2C bus time the manager may start per frame, in us
+#define I2C_FRAME_BUDGET_US 1500
+// Drop of filtered data below baseline that counts as an early touch,
+// below the chip's own touch threshold E_THR_T
+#define EARLY_TOUCH_DELTA   10
+// Registers read with electrode data: status, out of range, filtered, baseline
+#define ELECTRODE_READ      0x2A
+
+// Drives up to four MPR121 keypads on one I2C bus.
+//
+// The chips' IRQ outputs share one open-drain line. When it falls every
+// chip is marked changed, and poll() reads their touch status round-robin
+// from the next player on. Reads are queued on the I2cQueue and finish in
+// its interrupt, which pushes each status that changed into that player's
+// queue. One chip per frame is also re-read in turn, in case an edge was
+// missed.
+//
+// Every read is charged to the frame at the bus's measured transfer time
+// and no read starts past I2C_FRAME_BUDGET_US, so adding controllers
+// delays reads rather than stretching the frame.
+class ControllerManager
+{
+public:
+    ControllerManager(I2cQueue *bus);
+
+    // Use a chip already configured elsewhere as the next player
+    int attach(Mpr121 *chip);
+
+    // Probe the addresses not used yet and configure the chips that answer.
+    // Returns the number of players.
+    int scan();
+
+    int players() const { return count; }
+    Mpr121 *chip(int player) { return chips[player]; }
+
+    // The shared IRQ line fell, call from its InterruptIn
+    void irq();
+
+    // Start the reads this frame's budget allows, from the input task
+    void poll();
+
+    // Start a new frame budget, from the tick task
+    void frame();
+
+    // Also read filtered and baseline data, and report electrodes whose
+    // data dropped by EARLY_TOUCH_DELTA before the chip calls them touched.
+    // A read is then 42 bytes instead of 2.
+    void readElectrodeData(bool on) { electrodeData = on; }
+
+    // Next touch status of a player, -1 when none: bit n for electrode n
+    // touched, bit 16+n for electrode n early
+    int next(int player);
+
+    // Status changes waiting for a player
+    int depth(int player) const { return (heads[player] - tails[player]) & (INPUT_QUEUE - 1); }
+
+    // Statistics
+    int reads;          // touch status reads started
+    int irqReads;       // of those, for a flagged chip
+    int deferred;       // flagged chips left for the next frame by the budget
+    int dropped;        // status changes lost to a full player queue
+    int failed;         // reads that ended in an I2C error
+    int spentUs;        // budget used this frame
+
+private:
+    struct Slot {
+        ControllerManager *owner;
+        int player;
+    };
+
+    static void readDone(void *ctx, int status);
+    bool start(int player);
+    int cost();
+
+    I2cQueue *bus;
+    Mpr121 *chips[MAX_PLAYERS];
+    int count;
+
+    // chips built by scan(), without the heap
+    unsigned int storage[MAX_PLAYERS][(sizeof(Mpr121) + 3) / 4];
+
+    Slot slots[MAX_PLAYERS];
+    unsigned char status[MAX_PLAYERS][ELECTRODE_READ];
+    bool electrodeData;
+    int last[MAX_PLAYERS];          // last status queued
+    volatile bool busy[MAX_PLAYERS]; // read on the bus
+    volatile int changed;           // players flagged by the IRQ, one bit each
+    int turn;                       // next player in the round-robin
+    int refresh;                    // next player for the background re-read
+    bool refreshed;                 // background re-read done this frame
+
+    volatile int heads[MAX_PLAYERS];
+    int tails[MAX_PLAYERS];
+    unsigned int queue[MAX_PLAYERS][INPUT_QUEUE];
+};
+
+#endif
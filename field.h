@@ -0,0 +1,21 @@
+#ifndef FIELD_GEOMETRY_H
+#define FIELD_GEOMETRY_H
+
+// Playfield geometry, in 8x8 pixel cells.
+// The white border runs along pixels 7..623 x 23..463, so the cells a
+// snake can live in are 2..76 x 4..56.
+
+#define CELL_SIZE       8
+
+#define FIELD_W         78
+#define FIELD_H         58
+
+#define FIELD_MIN_X     2
+#define FIELD_MAX_X     76
+#define FIELD_MIN_Y     4
+#define FIELD_MAX_Y     56
+
+//pixel position of a playfield cell
+#define CELL_PX(c)      (((c)*CELL_SIZE)-1)
+
+#endif
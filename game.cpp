@@ -0,0 +1,299 @@
+#include "string.h"
+#include "game.h"
+
+// Length of a new snake
+#define START_LENGTH    30
+
+Game::Game()
+{
+    reset();
+}
+
+void Game::reset(int players, unsigned int seed)
+{
+    if (players < 1)
+        players = 1;
+    if (players > GAME_MAX_SNAKES)
+        players = GAME_MAX_SNAKES;
+    this->players = players;
+
+    memset(occ, 0, sizeof(occ));
+    for (int y = 0; y < FIELD_H; y++)
+        rowFree[y] = (y >= FIELD_MIN_Y && y <= FIELD_MAX_Y) ? FIELD_MAX_X - FIELD_MIN_X + 1 : 0;
+    freeTotal = (FIELD_MAX_X - FIELD_MIN_X + 1) * (FIELD_MAX_Y - FIELD_MIN_Y + 1);
+
+    //create the beginning snakes, 30 parts long heading right
+    for (int i = 0; i < players; i++) {
+        Snake &s = snakes[i];
+        s.body.reset(8, 16 + 10 * i);
+        set(8, 16 + 10 * i);
+        for (int n = 1; n < START_LENGTH; n++) {
+            s.body.advance(DIR_RIGHT, true);
+            set(s.body.headX(), s.body.headY());
+        }
+        s.heading = DIR_RIGHT;
+        s.turnCount = 0;
+        s.points = 0;
+        s.alive = true;
+        s.events = 0;
+        s.tailx = -1;
+        s.taily = -1;
+    }
+
+    //xorshift never leaves 0
+    this->seed = seed;
+    state = seed ? seed : 1;
+
+    over = false;
+    ticks = 0;
+    turnsQueued = 0;
+    turnsDropped = 0;
+    turnsLost = 0;
+    placeApple();
+}
+
+int Game::keyHeading(int key)
+{
+    switch (key) {
+        case 1:
+            return DIR_UP;
+        case 6:
+            return DIR_RIGHT;
+        case 5:
+            return DIR_DOWN;
+        case 4:
+            return DIR_LEFT;
+    }
+    return -1;
+}
+
+bool Game::steer(int player, int key)
+{
+    return turn(player, keyHeading(key));
+}
+
+bool Game::turn(int player, int h)
+{
+    if (h < 0 || player >= players)
+        return false;
+
+    //a turn follows the last one queued, or the heading when there is none
+    Snake &s = snakes[player];
+    int last = s.turnCount ? s.turns[s.turnCount - 1] : s.heading;
+    if (h == last || h == (last ^ 2)) {
+        turnsDropped++;
+        return false;
+    }
+    if (s.turnCount == TURN_QUEUE) {
+        turnsLost++;
+        return false;
+    }
+    s.turns[s.turnCount++] = h;
+    turnsQueued++;
+    return true;
+}
+
+void Game::place(int player, int x, int y, int heading, int length)
+{
+    Snake &s = snakes[player];
+    for (SnakeBody::iterator it = s.body.begin(); !it.done(); it.next())
+        clear(it.x, it.y);
+
+    s.body.reset(x, y);
+    set(x, y);
+    for (int n = 1; n < length; n++) {
+        s.body.advance(heading, true);
+        set(s.body.headX(), s.body.headY());
+    }
+    s.heading = heading;
+    s.turnCount = 0;
+}
+
+void Game::set(int x, int y)
+{
+    if (occupied(x, y))
+        return;
+    occ[y][x >> 5] |= 1u << (x & 31);
+    if (x >= FIELD_MIN_X && x <= FIELD_MAX_X && y >= FIELD_MIN_Y && y <= FIELD_MAX_Y) {
+        rowFree[y]--;
+        freeTotal--;
+    }
+}
+
+void Game::clear(int x, int y)
+{
+    if (!occupied(x, y))
+        return;
+    occ[y][x >> 5] &= ~(1u << (x & 31));
+    if (x >= FIELD_MIN_X && x <= FIELD_MAX_X && y >= FIELD_MIN_Y && y <= FIELD_MAX_Y) {
+        rowFree[y]++;
+        freeTotal++;
+    }
+}
+
+// Uniform over the free cells: pick the n-th one, find its row from the
+// row counts, then walk that row only
+void Game::placeApple()
+{
+    if (freeTotal == 0) {
+        foodx = -1;
+        foody = -1;
+        return;
+    }
+
+    int n = random(freeTotal);
+    int y = FIELD_MIN_Y;
+    while (n >= rowFree[y])
+        n -= rowFree[y++];
+
+    int x = FIELD_MIN_X;
+    for (;; x++) {
+        if (!occupied(x, y) && n-- == 0)
+            break;
+    }
+    foodx = x;
+    foody = y;
+}
+
+// 0 to n-1, from a 32 bit xorshift
+int Game::random(int n)
+{
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state % n;
+}
+
+// FNV-1a over the occupancy, apple, generator and each snake's head, heading,
+// turns waiting, length and points
+unsigned int Game::checksum() const
+{
+    unsigned int h = 2166136261u;
+    const unsigned char *p = (const unsigned char *)occ;
+    for (unsigned int i = 0; i < sizeof(occ); i++)
+        h = (h ^ p[i]) * 16777619u;
+
+    int values[4 + GAME_MAX_SNAKES * 7];
+    int n = 0;
+    values[n++] = foodx;
+    values[n++] = foody;
+    values[n++] = (int)state;
+    values[n++] = ticks;
+    for (int i = 0; i < players; i++) {
+        const Snake &s = snakes[i];
+        values[n++] = s.body.headX();
+        values[n++] = s.body.headY();
+        values[n++] = s.heading;
+        values[n++] = s.turnCount ? s.turns[0] : -1;
+        values[n++] = s.body.length();
+        values[n++] = s.points;
+        values[n++] = s.alive;
+    }
+    for (int i = 0; i < n; i++)
+        for (int b = 0; b < 32; b += 8)
+            h = (h ^ ((values[i] >> b) & 0xFF)) * 16777619u;
+    return h;
+}
+
+int Game::tick()
+{
+    if (over)
+        return GAME_OVER;
+
+    int hx[GAME_MAX_SNAKES], hy[GAME_MAX_SNAKES];
+    bool grow[GAME_MAX_SNAKES];
+    bool moving[GAME_MAX_SNAKES];
+    int events = 0;
+
+    ticks++;
+
+    //new heads; tails leave first so a head may follow a tail
+    for (int i = 0; i < players; i++) {
+        Snake &s = snakes[i];
+        s.events = 0;
+        s.tailx = -1;
+        s.taily = -1;
+        moving[i] = s.alive;
+        if (!s.alive)
+            continue;
+
+        //one queued turn per tick; steer() already refused reversals
+        if (s.turnCount) {
+            s.heading = s.turns[0];
+            for (int n = 1; n < s.turnCount; n++)
+                s.turns[n - 1] = s.turns[n];
+            s.turnCount--;
+        }
+
+        hx[i] = s.body.headX() + dir_dx[s.heading];
+        hy[i] = s.body.headY() + dir_dy[s.heading];
+        grow[i] = (hx[i] == foodx && hy[i] == foody);
+        if (!grow[i])
+            clear(s.body.tailX(), s.body.tailY());
+    }
+
+    //one pass over the new heads: walls, bodies, then other heads. A snake
+    //that dies does not move, so its tail comes back and the pass repeats
+    //for heads that went there. Heads meeting are checked against every
+    //snake that tried to move, so both die whichever is looked at first.
+    bool attempted[GAME_MAX_SNAKES];
+    for (int i = 0; i < players; i++)
+        attempted[i] = moving[i];
+    for (bool again = true; again; ) {
+        again = false;
+        for (int i = 0; i < players; i++) {
+            if (!moving[i])
+                continue;
+
+            bool dead = hx[i] < FIELD_MIN_X || hx[i] > FIELD_MAX_X ||
+                        hy[i] < FIELD_MIN_Y || hy[i] > FIELD_MAX_Y ||
+                        occupied(hx[i], hy[i]);
+            for (int j = 0; j < players; j++) {
+                if (j != i && attempted[j] && hx[j] == hx[i] && hy[j] == hy[i])
+                    dead = true;
+            }
+            if (dead) {
+                moving[i] = false;
+                snakes[i].events |= GAME_DIED;
+                if (!grow[i]) {
+                    set(snakes[i].body.tailX(), snakes[i].body.tailY());
+                    again = true;
+                }
+            }
+        }
+    }
+
+    bool eaten = false;
+    int alive = 0;
+    for (int i = 0; i < players; i++) {
+        Snake &s = snakes[i];
+        if (s.events & GAME_DIED)
+            s.alive = false;
+        if (!moving[i]) {
+            events |= s.events;
+            continue;
+        }
+
+        if (grow[i]) {
+            //grow by keeping the tail in place
+            s.points++;
+            s.events |= GAME_ATE;
+            eaten = true;
+        } else {
+            s.tailx = s.body.tailX();
+            s.taily = s.body.tailY();
+        }
+        s.body.advance(s.heading, grow[i]);
+        set(hx[i], hy[i]);
+        alive++;
+        events |= s.events;
+    }
+
+    if (eaten)
+        placeApple();
+
+    over = (players == 1) ? alive == 0 : alive <= 1;
+    if (over)
+        events |= GAME_OVER;
+    return events;
+}
@@ -0,0 +1,123 @@
+#ifndef GAME_H
+#define GAME_H
+
+#include "snakebody.h"
+#include "field.h"
+
+// Snakes in one game, one per player
+#define GAME_MAX_SNAKES 4
+
+// Events reported by Game::tick(), per snake and for the whole game
+#define GAME_ATE        0x01
+#define GAME_DIED       0x02
+#define GAME_OVER       0x04
+
+// Turns a snake can have waiting for its next ticks
+#define TURN_QUEUE      3
+
+// One player's snake
+struct Snake
+{
+    SnakeBody body;
+    int heading;
+
+    // headings asked for the next ticks, one is taken per tick
+    int turns[TURN_QUEUE];
+    int turnCount;
+    int points;
+    bool alive;
+
+    // what the last tick did to this snake, GAME_* flags
+    int events;
+
+    // cell left by the tail in the last tick, -1 when it did not leave one
+    int tailx;
+    int taily;
+};
+
+// Game state and rules for up to GAME_MAX_SNAKES snakes, in playfield cells.
+//
+// All snakes share one occupancy bitmap, so a tick only looks at each
+// snake's new head and old tail: its cost grows with the number of
+// players, not with their length. Heads are resolved in one pass: into a
+// wall or an occupied cell is death, and two heads meeting on the same
+// cell both die. A snake that dies does not move and stays on the field
+// as an obstacle.
+//
+// Apples are drawn from the free cells. Per-row free counts pick the row
+// of a uniformly chosen free cell, so placing one never scans the bodies.
+// The draw uses the game's own generator rather than rand(), so a seed and
+// the turns taken replay a game exactly, on the mbed or a host.
+//
+// Nothing here touches mbed or the display, so a tick can run from the
+// scheduler's tick task or on a host.
+class Game
+{
+public:
+    Game();
+
+    // New game: 30 segment snakes heading right on rows 16, 26, ... and a
+    // first apple. Apples are placed from seed.
+    void reset(int players = 1, unsigned int seed = 1);
+
+    // Keypad code (1 up, 6 right, 5 down, 4 left) for a snake, 0 for none.
+    // The turn is queued behind the ones not taken yet, so two quick turns
+    // between ticks both happen. It is checked against the last heading
+    // queued: the same heading or a reversal is dropped, as is a turn with
+    // TURN_QUEUE already waiting. Returns true when it was queued.
+    bool steer(int player, int key);
+
+    // Same with a heading, for the autopilot
+    bool turn(int player, int heading);
+
+    // Lay a snake out again, straight from a tail at x, y along heading and
+    // length cells long, with no turns waiting. For host tests that need
+    // positions no game from reset() reaches: all heads keep one colour of
+    // the checkerboard there, so two heads are never next to each other.
+    void place(int player, int x, int y, int heading, int length);
+
+    // Move every live snake one cell, returns the GAME_* flags of all snakes
+    int tick();
+
+    // Heading for a keypad code, -1 when the code is not a direction
+    static int keyHeading(int key);
+
+    bool occupied(int x, int y) const { return (occ[y][x >> 5] >> (x & 31)) & 1; }
+    int freeCells() const { return freeTotal; }
+
+    // Hash of everything a tick depends on, to check a replay against
+    unsigned int checksum() const;
+
+    int players;
+    Snake snakes[GAME_MAX_SNAKES];
+    int foodx;
+    int foody;
+
+    // every snake is dead, or one is left in a game for several
+    bool over;
+
+    // seed given to reset()
+    unsigned int seed;
+
+    // Statistics
+    int ticks;
+    int turnsQueued;
+    int turnsDropped;   // same heading or reversal of the last one queued
+    int turnsLost;      // queue full
+
+private:
+    void set(int x, int y);
+    void clear(int x, int y);
+    void placeApple();
+    int random(int n);
+
+    // occupancy of every snake cell, and free cells per playfield row
+    unsigned int occ[FIELD_H][(FIELD_W + 31) / 32];
+    unsigned char rowFree[FIELD_H];
+    int freeTotal;
+
+    // xorshift state of the apple generator
+    unsigned int state;
+};
+
+#endif
@@ -0,0 +1,366 @@
+#include "i2cqueue.h"
+
+#if I2C_QUEUE_HOST
+#include "mpr121sim.h"
+#define LOCK()
+#define UNLOCK()
+#else
+#include "us_ticker_api.h"
+#define LOCK()      __disable_irq()
+#define UNLOCK()    __enable_irq()
+
+// I2CONSET / I2CONCLR bits
+#define I2C_AA      0x04
+#define I2C_SI      0x08
+#define I2C_STO     0x10
+#define I2C_STA     0x20
+#define I2C_EN      0x40
+
+I2cQueue *I2cQueue::instances[3];
+#endif
+
+// LPC17xx master state codes
+#define ST_BUS_ERROR        0x00
+#define ST_START            0x08
+#define ST_RESTART          0x10
+#define ST_SLA_W_ACK        0x18
+#define ST_SLA_W_NACK       0x20
+#define ST_DATA_W_ACK       0x28
+#define ST_DATA_W_NACK      0x30
+#define ST_ARB_LOST         0x38
+#define ST_SLA_R_ACK        0x40
+#define ST_SLA_R_NACK       0x48
+#define ST_DATA_R_ACK       0x50
+#define ST_DATA_R_NACK      0x58
+
+#if I2C_QUEUE_HOST
+I2cQueue::I2cQueue(I2cSim *bus)
+{
+    this->bus = bus;
+#else
+I2cQueue::I2cQueue(PinName sda, PinName scl) : i2c(sda, scl)
+{
+    //the mbed I2C object muxed the pins and set the clock, take over from it
+    int n = (sda == p9) ? 1 : 2;
+    regs = (n == 1) ? LPC_I2C1 : LPC_I2C2;
+    instances[n] = this;
+
+    regs->I2CONCLR = I2C_AA | I2C_SI | I2C_STA;
+    regs->I2CONSET = I2C_EN;
+
+    IRQn_Type irq = (n == 1) ? I2C1_IRQn : I2C2_IRQn;
+    NVIC_SetVector(irq, (n == 1) ? (uint32_t)&I2cQueue::isr1 : (uint32_t)&I2cQueue::isr2);
+    NVIC_EnableIRQ(irq);
+#endif
+    first = 0;
+    count = 0;
+    index = 0;
+    hz = 100000;
+    resetLatency();
+
+    completed = 0;
+    nacks = 0;
+    busErrors = 0;
+    overflows = 0;
+}
+
+bool I2cQueue::read(int address, int reg, unsigned char *data, int length, Done done, void *ctx)
+{
+    if (length < 1 || length > 255)
+        return false;
+
+    Request r;
+    r.address = address & 0xFE;
+    r.reg = reg;
+    r.length = length;
+    r.read = true;
+    r.dest = data;
+    r.done = done;
+    r.ctx = ctx;
+    return queue(r);
+}
+
+bool I2cQueue::write(int address, int reg, const unsigned char *data, int length, Done done, void *ctx)
+{
+    if (length < 0 || length > I2C_DATA_MAX)
+        return false;
+
+    Request r;
+    r.address = address & 0xFE;
+    r.reg = reg;
+    r.length = length;
+    r.read = false;
+    r.dest = 0;
+    for (int i = 0; i < length; i++)
+        r.data[i] = data[i];
+    r.done = done;
+    r.ctx = ctx;
+    return queue(r);
+}
+
+bool I2cQueue::queue(const Request &r)
+{
+    LOCK();
+    if (count == I2C_QUEUE_MAX) {
+        overflows++;
+        UNLOCK();
+        return false;
+    }
+    requests[(first + count) % I2C_QUEUE_MAX] = r;
+    count++;
+    bool idle = (count == 1);
+    UNLOCK();
+
+    //nothing running, so no interrupt can race with this
+    if (idle)
+        begin();
+    return true;
+}
+
+static void syncDone(void *ctx, int status)
+{
+    *(volatile int *)ctx = status;
+}
+
+int I2cQueue::readSync(int address, int reg, unsigned char *data, int length)
+{
+    volatile int status = I2C_PENDING;
+    if (!read(address, reg, data, length, syncDone, (void *)&status))
+        return I2C_FULL;
+    waitFor(&status);
+    return status;
+}
+
+int I2cQueue::writeSync(int address, int reg, const unsigned char *data, int length)
+{
+    volatile int status = I2C_PENDING;
+    if (!write(address, reg, data, length, syncDone, (void *)&status))
+        return I2C_FULL;
+    waitFor(&status);
+    return status;
+}
+
+// Bus time of a transaction at the current clock, in us: start, address,
+// register, then for a read a restart and the address again, the data
+// bytes and the stop
+uint32_t I2cQueue::busUs(const Request &r) const
+{
+    int bits = 2 + 9 * (2 + r.length) + (r.read ? 10 : 0);
+    return (bits * 1000000u + hz - 1) / hz;
+}
+
+// Wait for a blocking transfer, for the bus time of everything queued up to
+// and including it plus a margin. A bus that stops answering has its
+// transactions failed one by one until this one is done, so the callback
+// never writes to a status that went out of scope.
+void I2cQueue::waitFor(volatile int *status)
+{
+    LOCK();
+    uint32_t wait = I2C_SYNC_MARGIN_US;
+    for (int i = 0; i < count; i++)
+        wait += busUs(requests[(first + i) % I2C_QUEUE_MAX]);
+    uint32_t deadline = hwClock() + wait;
+    UNLOCK();
+
+    while (*status == I2C_PENDING && (int32_t)(hwClock() - deadline) < 0)
+        poll();
+    while (*status == I2C_PENDING) {
+        LOCK();
+        hwReset();
+        finish(I2C_BUS_ERROR);
+        UNLOCK();
+    }
+}
+
+void I2cQueue::resetLatency()
+{
+    last_us = 0;
+    max_us = 0;
+    total_us = 0;
+    timed = 0;
+}
+
+void I2cQueue::begin()
+{
+    index = 0;
+    started = hwClock();
+    hwStart();
+}
+
+void I2cQueue::finish(int status)
+{
+    Request &r = requests[first];
+    Done done = r.done;
+    void *ctx = r.ctx;
+
+    last_us = hwClock() - started;
+    if (last_us > max_us)
+        max_us = last_us;
+    total_us += last_us;
+    timed++;
+
+    completed++;
+    if (status == I2C_NACK)
+        nacks++;
+    else if (status == I2C_BUS_ERROR)
+        busErrors++;
+
+    first = (first + 1) % I2C_QUEUE_MAX;
+    count--;
+
+    if (done)
+        done(ctx, status);
+    if (count)
+        begin();
+}
+
+// One step of the running transaction, for each controller state code
+void I2cQueue::event(int stat)
+{
+    if (!count) {
+        hwStop();
+        return;
+    }
+    Request &r = requests[first];
+
+    switch (stat) {
+        case ST_START:
+            hwSend(r.address);
+            break;
+        case ST_RESTART:
+            hwSend(r.address | 1);
+            break;
+        case ST_SLA_W_ACK:
+            hwSend(r.reg);
+            break;
+        case ST_DATA_W_ACK:
+            if (r.read) {
+                //register number sent, turn the bus round
+                hwStart();
+            } else if (index < r.length) {
+                hwSend(r.data[index++]);
+            } else {
+                hwStop();
+                finish(I2C_OK);
+            }
+            break;
+        case ST_SLA_R_ACK:
+            hwReceive(r.length > 1);
+            break;
+        case ST_DATA_R_ACK:
+            r.dest[index++] = hwData();
+            hwReceive(index < r.length - 1);
+            break;
+        case ST_DATA_R_NACK:
+            r.dest[index++] = hwData();
+            hwStop();
+            finish(I2C_OK);
+            break;
+        case ST_SLA_W_NACK:
+        case ST_DATA_W_NACK:
+        case ST_SLA_R_NACK:
+            hwStop();
+            finish(I2C_NACK);
+            break;
+        default:
+            //ST_BUS_ERROR, ST_ARB_LOST or anything unexpected
+            hwStop();
+            finish(I2C_BUS_ERROR);
+            break;
+    }
+}
+
+#if I2C_QUEUE_HOST
+
+void I2cQueue::poll()
+{
+    int stat;
+    while (bus->next(&stat))
+        event(stat);
+}
+
+void I2cQueue::hwStart()          { bus->start(); }
+void I2cQueue::hwSend(int c)      { bus->send(c); }
+void I2cQueue::hwReceive(bool ack) { bus->receive(ack); }
+void I2cQueue::hwStop()           { bus->stop(); }
+int  I2cQueue::hwData()           { return bus->data(); }
+void I2cQueue::hwReset()          { bus->stop(); }
+uint32_t I2cQueue::hwClock()      { return bus->us; }
+
+void I2cQueue::frequency(int hz)
+{
+    this->hz = hz;
+    bus->frequency(hz);
+}
+
+#else
+
+void I2cQueue::poll()
+{
+}
+
+void I2cQueue::isr1()
+{
+    I2cQueue *q = instances[1];
+    q->event(q->regs->I2STAT);
+}
+
+void I2cQueue::isr2()
+{
+    I2cQueue *q = instances[2];
+    q->event(q->regs->I2STAT);
+}
+
+void I2cQueue::hwStart()
+{
+    //a start after a stop waits for the stop to complete
+    regs->I2CONSET = I2C_STA;
+    regs->I2CONCLR = I2C_SI;
+}
+
+void I2cQueue::hwSend(int c)
+{
+    regs->I2DAT = c;
+    regs->I2CONCLR = I2C_STA | I2C_SI;
+}
+
+void I2cQueue::hwReceive(bool ack)
+{
+    if (ack)
+        regs->I2CONSET = I2C_AA;
+    else
+        regs->I2CONCLR = I2C_AA;
+    regs->I2CONCLR = I2C_STA | I2C_SI;
+}
+
+void I2cQueue::hwStop()
+{
+    regs->I2CONSET = I2C_STO;
+    regs->I2CONCLR = I2C_STA | I2C_SI;
+}
+
+int I2cQueue::hwData()
+{
+    return regs->I2DAT;
+}
+
+uint32_t I2cQueue::hwClock()
+{
+    return us_ticker_read();
+}
+
+void I2cQueue::frequency(int hz)
+{
+    //mbed sets SCLH/SCLL from the peripheral clock
+    this->hz = hz;
+    i2c.frequency(hz);
+}
+
+void I2cQueue::hwReset()
+{
+    //drop whatever the controller was doing and release the bus
+    regs->I2CONCLR = I2C_EN | I2C_AA | I2C_SI | I2C_STA;
+    regs->I2CONSET = I2C_EN | I2C_STO;
+}
+
+#endif
@@ -0,0 +1,145 @@
+#ifndef I2CQUEUE_H
+#define I2CQUEUE_H
+
+// Build against the simulated bus in mpr121sim.h instead of the LPC1768
+#ifndef I2C_QUEUE_HOST
+#define I2C_QUEUE_HOST 0
+#endif
+
+#include <stdint.h>
+
+#if I2C_QUEUE_HOST
+class I2cSim;
+#else
+#include "mbed.h"
+#endif
+
+// Transactions waiting or running
+#define I2C_QUEUE_MAX       8
+// Largest register write, in bytes
+#define I2C_DATA_MAX        16
+// Time a blocking transfer waits past the bus time of the transactions
+// ahead of it and its own before giving up on the bus, in us
+#define I2C_SYNC_MARGIN_US  5000
+
+// Transaction status
+#define I2C_PENDING         1
+#define I2C_OK              0
+#define I2C_NACK            -1  // address or data byte not acknowledged
+#define I2C_BUS_ERROR       -2  // bus error, lost arbitration or timeout
+#define I2C_FULL            -3  // queue full, nothing was sent
+
+// Interrupt driven I2C master for register devices such as the MPR121.
+//
+// Register reads and writes are queued as descriptors and run one after
+// the other from the I2C interrupt, so the caller never waits on the bus.
+// Each one ends with a status and an optional completion callback, called
+// from the interrupt: keep it short.
+//
+// The transaction state machine is driven by the controller state codes of
+// the LPC17xx I2C block. On a host the same codes come from I2cSim.
+class I2cQueue
+{
+public:
+    typedef void (*Done)(void *ctx, int status);
+
+#if I2C_QUEUE_HOST
+    I2cQueue(I2cSim *bus);
+#else
+    // I2C1 on p9/p10 or I2C2 on p28/p27
+    I2cQueue(PinName sda, PinName scl);
+#endif
+
+    // Queue a read of length registers from reg onwards into data, which
+    // must stay valid until done. address is the 8 bit write address.
+    // Returns false when the queue is full.
+    bool read(int address, int reg, unsigned char *data, int length, Done done = 0, void *ctx = 0);
+
+    // Queue a write of length registers from reg onwards; data is copied
+    bool write(int address, int reg, const unsigned char *data, int length, Done done = 0, void *ctx = 0);
+
+    // Blocking forms, return the transaction status
+    int readSync(int address, int reg, unsigned char *data, int length);
+    int writeSync(int address, int reg, const unsigned char *data, int length);
+
+    // Transactions not finished yet
+    int pending() const { return count; }
+
+    // Bus clock, 100 kHz at power up, up to 400 kHz Fast-mode.
+    // Call with no transfer running.
+    void frequency(int hz);
+    int frequency() const { return hz; }
+
+    // Bus time of transactions, from start condition to stop, in us
+    int lastUs() const { return last_us; }
+    int maxUs() const { return max_us; }
+    int averageUs() const { return timed ? (int)(total_us / timed) : 0; }
+    void resetLatency();
+
+    // Let the bus make progress. Needed on a host, where there is no
+    // interrupt; a no-op on the LPC1768.
+    void poll();
+
+    // Statistics
+    int completed;      // transactions finished
+    int nacks;          // ended with I2C_NACK
+    int busErrors;      // ended with I2C_BUS_ERROR
+    int overflows;      // refused because the queue was full
+
+private:
+    struct Request {
+        unsigned char address;
+        unsigned char reg;
+        unsigned char length;
+        bool read;
+        unsigned char *dest;
+        unsigned char data[I2C_DATA_MAX];
+        Done done;
+        void *ctx;
+    };
+
+    bool queue(const Request &r);
+    void event(int stat);
+    void finish(int status);
+    void begin();
+    void waitFor(volatile int *status);
+    uint32_t busUs(const Request &r) const;
+
+    // controller actions
+    void hwStart();
+    void hwSend(int c);
+    void hwReceive(bool ack);
+    void hwStop();
+    int  hwData();
+    void hwReset();
+    uint32_t hwClock();
+
+    Request requests[I2C_QUEUE_MAX];
+    volatile int first;
+    volatile int count;
+
+    // progress of the running request
+    int index;          // next data byte
+    uint32_t started;   // hwClock() at its start condition
+
+    int hz;
+    int last_us;
+    int max_us;
+    uint32_t total_us;
+    int timed;
+    bool addressed;     // register number sent, read phase started
+
+#if I2C_QUEUE_HOST
+    I2cSim *bus;
+#else
+    static void isr1();
+    static void isr2();
+
+    I2C i2c;            // pin and clock setup
+    LPC_I2C_TypeDef *regs;
+
+    static I2cQueue *instances[3];
+#endif
+};
+
+#endif
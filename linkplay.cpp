@@ -0,0 +1,318 @@
+#include "linkplay.h"
+
+// Header bytes of an input packet before its inputs, sync and type included
+#define INPUT_HEADER    13
+
+static unsigned int word(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static int putWord(unsigned char *p, int n, unsigned int w)
+{
+    for (int b = 0; b < 32; b += 8)
+        p[n++] = (w >> b) & 0xFF;
+    return n;
+}
+
+// CRC-8, polynomial x^8 + x^2 + x + 1
+static int crc8(const unsigned char *p, int size)
+{
+    int crc = 0;
+    while (size--) {
+        crc ^= *p++;
+        for (int b = 0; b < 8; b++)
+            crc = crc & 0x80 ? ((crc << 1) ^ 0x07) & 0xFF : crc << 1;
+    }
+    return crc;
+}
+
+// Full tick from its low 16 bits, the one nearest base
+static int expand(int wire, int base)
+{
+    int d = (wire - base) & 0xFFFF;
+    if (d >= 0x8000)
+        d -= 0x10000;
+    return base + d;
+}
+
+LinkPlay::LinkPlay(Read read, Write write, void *ctx)
+{
+    this->read = read;
+    this->write = write;
+    this->ctx = ctx;
+    begin(0);
+}
+
+void LinkPlay::begin(unsigned int nonce, Replay *record)
+{
+    this->nonce = nonce;
+    this->record = record;
+    peerNonce = 0;
+    havePeer = false;
+    peerSeen = false;
+    started = false;
+    localPlayer = 0;
+    seed = 0;
+
+    turnCount = 0;
+    ticks = 0;
+    confirmedTicks = 0;
+    remoteTicks = 0;
+    peerAck = 0;
+    wrongFrom = -1;
+    overTick = 0;
+    checkTick = 0;
+    for (int i = 0; i < LINK_SUMS; i++)
+        sumTicks[i] = -1;
+    rxLen = 0;
+
+    rollbacks = 0;
+    resimulated = 0;
+    maxRollback = 0;
+    stalls = 0;
+    waiting = 0;
+    sent = 0;
+    received = 0;
+    badPackets = 0;
+    checks = 0;
+    desyncs = 0;
+}
+
+void LinkPlay::start(Game &game)
+{
+    bool host = nonce > peerNonce;
+    localPlayer = host ? 0 : 1;
+    seed = host ? nonce : peerNonce;
+    game.reset(2, seed);
+    confirmed = game;
+    sums[0] = confirmed.checksum();
+    sumTicks[0] = 0;
+    if (record)
+        record->start(confirmed);
+    started = true;
+}
+
+bool LinkPlay::steer(const Game &game, int heading)
+{
+    if (heading < 0 || !started)
+        return false;
+
+    //like Game::turn(), against the last turn queued
+    int last = turnCount ? turns[turnCount - 1] : game.snakes[localPlayer].heading;
+    if (heading == last || heading == (last ^ 2) || turnCount == TURN_QUEUE)
+        return false;
+    turns[turnCount++] = heading;
+    return true;
+}
+
+bool LinkPlay::poll(Game &game)
+{
+    int c;
+    while ((c = read(ctx)) >= 0)
+        take(c, game);
+    return settle(game);
+}
+
+// Bytes of the packet being received, 0 while not known yet, -1 for none
+int LinkPlay::length() const
+{
+    if (rxLen < 2)
+        return 0;
+    if (rx[1] == LINK_HELLO)
+        return 2 + 5 + 1;
+    if (rx[1] != LINK_INPUT || (rxLen > 4 && rx[4] > LINK_WINDOW))
+        return -1;
+    return rxLen > 4 ? INPUT_HEADER + rx[4] + 1 : 0;
+}
+
+void LinkPlay::take(int byte, Game &game)
+{
+    //bytes before a sync are noise, or what is left of a bad packet
+    if (rxLen == 0 && byte != LINK_SYNC)
+        return;
+    rx[rxLen++] = byte;
+
+    int size = length();
+    if (size < 0) {
+        badPackets++;
+        rxLen = 0;
+        return;
+    }
+    if (size == 0 || rxLen < size)
+        return;
+
+    rxLen = 0;
+    if (crc8(rx + 1, size - 2) != rx[size - 1]) {
+        badPackets++;
+        return;
+    }
+    received++;
+    if (rx[1] == LINK_HELLO)
+        hello(game);
+    else
+        input(game);
+}
+
+void LinkPlay::hello(Game &game)
+{
+    if (started)
+        return;
+    peerNonce = word(rx + 2);
+    havePeer = true;
+    if (rx[6])
+        peerSeen = true;
+    if (peerSeen && peerNonce != nonce)
+        start(game);
+}
+
+void LinkPlay::input(Game &game)
+{
+    //the peer only sends inputs once it has our nonce and we have its
+    if (!started) {
+        if (!havePeer || peerNonce == nonce)
+            return;
+        start(game);
+    }
+
+    int ack = expand(rx[5] | (rx[6] << 8), peerAck);
+    if (ack > peerAck && ack <= ticks)
+        peerAck = ack;
+
+    //inputs already received come again until acknowledged
+    int first = expand(rx[2] | (rx[3] << 8), remoteTicks);
+    for (int i = 0; i < rx[4]; i++) {
+        int t = first + i;
+        if (t != remoteTicks)
+            continue;
+        if (t >= confirmedTicks + LINK_WINDOW)
+            break;
+        int in = rx[INPUT_HEADER + i];
+        remoteIn[t % LINK_WINDOW] = in;
+        remoteTicks++;
+        //ticks already run took no turn for it
+        if (t < ticks && in && (wrongFrom < 0 || t < wrongFrom))
+            wrongFrom = t;
+    }
+
+    int at = expand(rx[7] | (rx[8] << 8), confirmedTicks);
+    int k = (at / LINK_CHECK) % LINK_SUMS;
+    if (at >= 0 && at % LINK_CHECK == 0 && sumTicks[k] == at) {
+        checks++;
+        if (sums[k] != word(rx + 9))
+            desyncs++;
+    }
+}
+
+// Turns for a tick into a game: both players' inputs, or no turn for a
+// remote one not received yet
+void LinkPlay::apply(Game &game, int tick, Replay *rec)
+{
+    for (int p = 0; p < 2; p++) {
+        int in;
+        if (p == localPlayer)
+            in = localIn[tick % LINK_WINDOW];
+        else
+            in = tick < remoteTicks ? remoteIn[tick % LINK_WINDOW] : 0;
+        if (in && game.turn(p, in & 3) && rec)
+            rec->turn(p, in & 3);
+    }
+}
+
+bool LinkPlay::settle(Game &game)
+{
+    if (!started)
+        return false;
+
+    //ticks with both inputs in join the agreed game
+    int known = remoteTicks < ticks ? remoteTicks : ticks;
+    while (confirmedTicks < known && !confirmed.over) {
+        apply(confirmed, confirmedTicks, record);
+        confirmed.tick();
+        confirmedTicks++;
+        if (record)
+            record->tick();
+        if (confirmed.over)
+            overTick = confirmedTicks;
+        if (confirmedTicks % LINK_CHECK == 0) {
+            int k = (confirmedTicks / LINK_CHECK) % LINK_SUMS;
+            sums[k] = confirmed.checksum();
+            sumTicks[k] = confirmedTicks;
+            checkTick = confirmedTicks;
+        }
+    }
+    if (wrongFrom < 0)
+        return false;
+    wrongFrom = -1;
+
+    //back to the agreed game, then forward again with what is known now
+    game = confirmed;
+    for (int t = confirmedTicks; t < ticks; t++) {
+        apply(game, t, 0);
+        game.tick();
+    }
+    int again = ticks - confirmedTicks;
+    rollbacks++;
+    resimulated += again;
+    if (again > maxRollback)
+        maxRollback = again;
+    return true;
+}
+
+int LinkPlay::tick(Game &game)
+{
+    int events = -1;
+
+    if (started && !over()) {
+        if (ticks - confirmedTicks < LINK_WINDOW && ticks - peerAck < LINK_WINDOW) {
+            int in = 0;
+            if (turnCount) {
+                in = LINK_TURN | turns[0];
+                for (int n = 1; n < turnCount; n++)
+                    turns[n - 1] = turns[n];
+                turnCount--;
+            }
+            localIn[ticks % LINK_WINDOW] = in;
+            apply(game, ticks, 0);
+            events = game.tick();
+            ticks++;
+            waiting = 0;
+        } else {
+            stalls++;
+            waiting++;
+        }
+    }
+    send();
+    return events;
+}
+
+void LinkPlay::send()
+{
+    unsigned char p[LINK_PACKET];
+    int n = 0;
+
+    p[n++] = LINK_SYNC;
+    if (!started) {
+        p[n++] = LINK_HELLO;
+        n = putWord(p, n, nonce);
+        p[n++] = havePeer;
+    } else {
+        //every input the peer has not acknowledged, and an agreed state
+        int k = (checkTick / LINK_CHECK) % LINK_SUMS;
+        p[n++] = LINK_INPUT;
+        p[n++] = peerAck & 0xFF;
+        p[n++] = (peerAck >> 8) & 0xFF;
+        p[n++] = ticks - peerAck;
+        p[n++] = remoteTicks & 0xFF;
+        p[n++] = (remoteTicks >> 8) & 0xFF;
+        p[n++] = checkTick & 0xFF;
+        p[n++] = (checkTick >> 8) & 0xFF;
+        n = putWord(p, n, sums[k]);
+        for (int t = peerAck; t < ticks; t++)
+            p[n++] = localIn[t % LINK_WINDOW];
+    }
+    p[n] = crc8(p + 1, n - 1);
+    n++;
+    write(ctx, p, n);
+    sent++;
+}
@@ -0,0 +1,150 @@
+#ifndef LINKPLAY_H
+#define LINKPLAY_H
+
+#include "game.h"
+#include "replay.h"
+
+// Ticks the local game may run ahead of the last one both boards agree on,
+// and of the last one the peer acknowledged
+#define LINK_WINDOW     32
+// Ticks between the state checksums the boards compare
+#define LINK_CHECK      8
+// Checksums kept to compare with the peer's
+#define LINK_SUMS       8
+
+// Packet layout, numbers little endian, ticks as their low 16 bits:
+//   0xA5, type, body, CRC-8 of type and body
+//   LINK_HELLO: nonce (4), 1 once the peer's nonce was received
+//   LINK_INPUT: first tick (2), count, ticks received from the peer (2),
+//               a checked tick (2), its Game::checksum() (4), count inputs
+// An input is 0 for no turn, or LINK_TURN | heading.
+#define LINK_SYNC       0xA5
+#define LINK_HELLO      1
+#define LINK_INPUT      2
+#define LINK_TURN       4
+#define LINK_PACKET     (2 + 11 + LINK_WINDOW + 1)
+
+// Two boards playing one game over a serial link, by rollback.
+//
+// Each board runs the whole game; only the inputs cross the link, one per
+// tick per player. A local turn goes into the next tick like in a game on
+// one board, so it never waits for the link. The remote player's input for
+// a tick not heard of yet is predicted as no turn, the common case.
+//
+// The state both boards agree on, up to the last tick with both inputs in,
+// is kept as one copy of the game. When a remote input arrives that differs
+// from the prediction, the local game is set back to that copy and the
+// ticks since are run again with it; a tick costs microseconds, so running
+// up to LINK_WINDOW of them again fits a frame. A board that gets
+// LINK_WINDOW ticks ahead waits for the other.
+//
+// Every packet carries all local inputs the peer has not acknowledged, so
+// a lost or corrupted packet is covered by the next one, and the checksum
+// of an agreed state, which the peer compares with its own.
+//
+// The boards find each other by sending their nonces: the larger one plays
+// snake 0 and is the seed of the game. Bytes go through read and write, so
+// the same code runs over an mbed UART or a host pseudo-terminal.
+class LinkPlay
+{
+public:
+    typedef int (*Read)(void *ctx);     // next byte received, -1 for none
+    typedef void (*Write)(void *ctx, const unsigned char *data, int size);
+
+    LinkPlay(Read read, Write write, void *ctx);
+
+    // Look for the other board. The nonces of the two must differ. When
+    // record is given the agreed game is recorded in it.
+    void begin(unsigned int nonce, Replay *record = 0);
+    bool connected() const { return started; }
+    int local() const { return localPlayer; }
+
+    // Heading asked for by the local player, queued for its next ticks like
+    // Game::turn(). Returns true when it was queued.
+    bool steer(const Game &game, int heading);
+
+    // Take what the link received. The game is reset when the boards
+    // connect, and rolled back and run again when a remote input was
+    // predicted wrong; returns true when it changed that way.
+    bool poll(Game &game);
+
+    // Tick the game with the next local input and the remote one or its
+    // prediction, and send. Returns the GAME_* flags of the tick, or -1
+    // when the game did not move: not connected, waiting or over.
+    int tick(Game &game);
+
+    // Send without ticking, so the peer gets what it is missing
+    void idle() { send(); }
+
+    // The agreed game is over, and both boards have all of its inputs
+    bool over() const { return confirmed.over; }
+    bool settled(int ticks) const { return confirmedTicks >= ticks && peerAck >= ticks; }
+    bool finished() const { return over() && settled(overTick); }
+
+    // The agreed game, for the end
+    const Game &agreed() const { return confirmed; }
+
+    int ticks;              // ticks the local game ran
+    int confirmedTicks;     // ticks of the agreed game
+    unsigned int seed;
+
+    // Statistics
+    int rollbacks;
+    int resimulated;        // ticks run again
+    int maxRollback;        // most ticks run again by one rollback
+    int stalls;             // tick() calls waiting for the peer
+    int waiting;            // of those, in a row until now
+    int sent;
+    int received;
+    int badPackets;         // CRC errors and unknown types
+    int checks;             // agreed states compared with the peer's
+    int desyncs;            // of those, different
+
+private:
+    void start(Game &game);
+    void take(int byte, Game &game);
+    int length() const;
+    void hello(Game &game);
+    void input(Game &game);
+    bool settle(Game &game);
+    void apply(Game &game, int tick, Replay *rec);
+    void send();
+
+    Read read;
+    Write write;
+    void *ctx;
+    Replay *record;
+
+    unsigned int nonce;
+    unsigned int peerNonce;
+    bool havePeer;          // peer's nonce received
+    bool peerSeen;          // peer has ours
+    bool started;
+    int localPlayer;
+
+    // local turns waiting for their ticks
+    int turns[TURN_QUEUE];
+    int turnCount;
+
+    // inputs by tick modulo LINK_WINDOW: local ones from the older of the
+    // agreed and acknowledged ticks, remote ones from the agreed tick
+    unsigned char localIn[LINK_WINDOW];
+    unsigned char remoteIn[LINK_WINDOW];
+    int remoteTicks;        // remote inputs received, in order
+    int peerAck;            // local inputs the peer has
+    int wrongFrom;          // first tick predicted wrong, -1 for none
+    int overTick;
+
+    // checksums of agreed states every LINK_CHECK ticks
+    unsigned int sums[LINK_SUMS];
+    int sumTicks[LINK_SUMS];
+    int checkTick;
+
+    // packet being received
+    unsigned char rx[LINK_PACKET];
+    int rxLen;
+
+    Game confirmed;
+};
+
+#endif
@@ -2,202 +2,624 @@
 #include "stdlib.h"
 #include "TFT_4DGL.h"
 #include "mpr121.h"
-#include <list>
+#include "controllers.h"
+#include "touchpad.h"
 #include "snake.h"
+#include "us_ticker_api.h"
+#include "game.h"
+#include "field.h"
+#include "renderer.h"
+#include "tilecache.h"
+#include "scheduler.h"
+#include "autopilot.h"
+#include "replay.h"
+#include "memplan.h"
+#include "linkplay.h"
 
 using namespace std;
 
-// overwrite 4DGL library screen size settings in TFT_4DGL.h
-#define SIZE_X  479
-#define SIZE_Y  639
-//
-
 InterruptIn interrupt(p26); // Create the interrupt receiver object on pin 26
-TFT_4DGL vga(p9,p10,p11);   // serial tx, serial rx, reset pin;
-I2C i2c(p28, p27);          // Setup the i2c bus on pins 28 and 27
+TFT_4DGL vga(p9,p10,p11,115200);   // serial tx, serial rx, reset pin, link speed;
+I2cQueue i2c(p28, p27);     // Setup the interrupt driven i2c bus on pins 28 and 27
 Mpr121 mpr121(&i2c, Mpr121::ADD_VSS);  // Setup the Mpr121:
+ControllerManager controllers(&i2c);   // player keypads, mpr121 first
 
 
 
 //Global Functions
 int keyint(void);
+int keycode(int value);
 //Global Constants
 char const digit[10] = {'0', '1', '2', '3', '4', '5', '6', '7', '8', '9'};
 //Global frame count
 int ticker;
+//ms from power up to the first complete frame
+int first_frame_ms;
+//Game state, kept in playfield cells, in the second AHB SRAM bank
+Game game IN_AHBSRAM1;
+//Tile store right of the playfield border, and playfield drawing
+TileCache tiles(&vga, 627, 24, 9, 432);
+Renderer renderer IN_AHBSRAM1 (&vga, &tiles);
+
+//Tasks sharing the CPU, timed by the microsecond ticker
+Scheduler sched(us_ticker_read);
+int submit_task;
+//key of each player last seen by the input task, a new one is queued as a turn
+int last_key[GAME_MAX_SNAKES];
+//taps, holds and slides of each keypad
+TouchDecoder decoders[GAME_MAX_SNAKES] = {
+    TouchDecoder(&keypadLayout, us_ticker_read), TouchDecoder(&keypadLayout, us_ticker_read),
+    TouchDecoder(&keypadLayout, us_ticker_read), TouchDecoder(&keypadLayout, us_ticker_read)
+};
+
+//Attract mode: time at the end of the game over prompt before a demo game,
+//and after the demo before the screen dims and the keypads go to proximity
+//sensing, and the wake time aimed for
+#define IDLE_AFTER_S        10
+#define IDLE_WAKE_BUDGET_US 5000
+
+//Build with SOAK_TEST 1 to have the autopilot play game after game
+#ifndef SOAK_TEST
+#define SOAK_TEST           0
+#endif
+
+//Autopilot for demo games. Its search arrays take most of the AHB SRAM bank
+//the Ethernet and USB drivers would use, which this program does not.
+Autopilot autopilot IN_AHBSRAM0;
+//the autopilot is playing, and a touch asked for a real game
+bool demo = SOAK_TEST;
+bool demo_quit;
+
+//Seed and turns of the game being played, saved when it ends. The buffer
+//goes in the second AHB SRAM bank, also free in this program.
+Replay replay IN_AHBSRAM1;
+LocalFileSystem local("local");
+
+//Build with LINK_PLAY 1 for two boards playing each other over a UART
+#ifndef LINK_PLAY
+#define LINK_PLAY           0
+#endif
+
+#if LINK_PLAY
+//Link to the other board on the second UART, its TX p13 to the other's RX
+//p14 and the grounds joined. The RX interrupt buffers what arrives.
+#define LINK_BAUD           115200
+#define LINK_RX_BUFFER      128
+//Ticks waiting for the other board before the game is given up
+#define LINK_GIVE_UP        180
+
+Serial link_uart(p13, p14);
+unsigned char link_rx[LINK_RX_BUFFER];
+volatile int link_rx_head;
+int link_rx_tail;
+
+void linkRx()
+{
+    while(link_uart.readable()) {
+        link_rx[link_rx_head] = link_uart.getc();
+        link_rx_head = (link_rx_head + 1) % LINK_RX_BUFFER;
+    }
+}
 
+int linkRead(void *)
+{
+    if(link_rx_tail == link_rx_head)
+        return -1;
+    int c = link_rx[link_rx_tail];
+    link_rx_tail = (link_rx_tail + 1) % LINK_RX_BUFFER;
+    return c;
+}
 
-int main()
+//A packet is a few bytes with the link keeping up, it mostly fits the
+//UART's transmit FIFO
+void linkWrite(void *, const unsigned char *data, int size)
 {
-    //display handshake
-    vga.baudrate(115200);
-    
-    //added - Set Display to 640 by 480 mode
-    vga.display_control(0x0c, 0x01);
-    vga.background_color(BLACK);
-    vga.set_font(FONT_8X8);
-    vga.text_mode(TRANSPARENT);
+    for(int i = 0; i < size; i++)
+        link_uart.putc(data[i]);
+}
 
-    //Restart entry point
-restart:
+//Two-board game, with its agreed copy of the game
+LinkPlay linkplay(linkRead, linkWrite, 0);
+//the link rolled the game back since the tick task last drew
+bool link_rewound;
+#endif
+
+//Local bank left to the mbed and C libraries: their statics, stdio buffers
+//and the heap
+#define RAM_LIB_RESERVE     0x3000
+
+//The banks hold what is put in them, with the stack budget and the
+//libraries' share of the local bank
+MEM_CHECK(sizeof(Autopilot) <= RAM_AHB_SIZE, ahbsram0_fits);
+MEM_CHECK(sizeof(Replay) + sizeof(Game) + sizeof(Renderer) <= RAM_AHB_SIZE, ahbsram1_fits);
+MEM_CHECK(sizeof(TFT_4DGL) + sizeof(I2cQueue) + sizeof(ControllerManager) + sizeof(decoders) +
+          sizeof(Scheduler) + sizeof(TileCache) + (LINK_PLAY ? sizeof(LinkPlay) : 0) +
+          STACK_BUDGET + RAM_LIB_RESERVE <= RAM_MAIN_SIZE,
+          main_fits);
+
+//touch IRQ seen while idle, and when
+volatile bool woke;
+volatile uint32_t woke_us;
+//time from the IRQ to touch sensing and backlight back on
+int wake_us;
+int wake_max_us;
+int wake_overruns;
+
+//Touch IRQ, shared by all keypads
+void touchIrq()
+{
+    if(!woke) {
+        woke_us = us_ticker_read();
+        woke = true;
+    }
+    controllers.irq();
+}
 
-    vga.cls();
+//Start this frame's keypad reads and take the finished ones
+void inputTask(void *)
+{
+    controllers.poll();
+
+    uint32_t now = us_ticker_read();
+    for(int p = 0; p < game.players; p++) {
+        int value;
+        bool fed = false;
+        while((value = controllers.next(p)) >= 0) {
+            decoders[p].update(value, now);
+            //every new key goes to the game's turn queue, so a quick turn
+            //and the one after it are both kept until their ticks
+            int key = decoders[p].key();
+            if(key && key != last_key[p]) {
+#if LINK_PLAY
+                //the first keypad steers this board's snake
+                if(p == 0)
+                    linkplay.steer(game, Game::keyHeading(key));
+#else
+                if(!demo) {
+                    if(game.steer(p, key))
+                        replay.turn(p, Game::keyHeading(key));
+                } else if(!SOAK_TEST)
+                    demo_quit = true;
+#endif
+            }
+            last_key[p] = key;
+            fed = true;
+        }
+        if(!fed)
+            decoders[p].tick(now);
 
+        //events are only counted for now, the game steers with key()
+        TouchEvent e;
+        while(decoders[p].next(&e))
+            ;
+    }
+}
 
-    //game variables
-    list<snake> snakes;
-    list<snake>::iterator it;
-    bool quit = false;
-    int points = 0;
-    int x = 0;
-    int y = 0;
-    int foodx = (rand() % 73) + 2;
-    int foody = (rand() % 52) + 4;
-    int dir = 6;
-    int last_dir = 0;
-
-    //set up field
-    vga.line(7,23,623, 23, WHITE);
-    vga.line(7,23,7, 463, WHITE);
-    vga.line(623,23, 623, 463, WHITE);
-    vga.line(7, 463, 623, 463, WHITE);
-    vga.text_string("SCORE:", 2, 1, FONT_8X8, WHITE);
-    vga.text_char(digit[points%10], 9, 1, WHITE);
+int inputDepth(void *)
+{
+    return i2c.pending();
+}
 
-    //set frame ticker
-    ticker = 0;
-    //initialize timer class
-    Timer timer;
-
-    //seed random number generator
-    srand(time(NULL));
-
-    //start timer
-    timer.start();
-
-    //display first apple
-    vga.rectangle((foodx*8)-1, (foody*8)-1 ,(foodx*8)+7, (foody*8)+7, RED);
-
-    //create list of snake class
-    for(int i =0; i < 30; i++)
-        snakes.push_front(snake( 63 + (i*8), 127, 8, GREEN));
-
-    //draw beginning snake parts
-    for(it = snakes.begin(); it != snakes.end(); it++) {
-        (*it).draw();
-    }
-
-    while( !quit ) {
-        //start Time for fps limit
-        timer.reset();
-
-        //grab old head of snake's coordinates
-        x = snakes.front().x;
-        y = snakes.front().y;
-
-        //create coordinates for new location of head
-        
-        //Guard to keep snake moving once per frame
-        if(dir == 0)
-            dir = last_dir;
-        
-        //movement control from input
-        //Snake cannot turn directly backwards and is always moving
-        if(dir == 1) {
-            if (last_dir != 5) {
-                y-=8;
-                last_dir = dir;
-            } else
-                y+=8;
-        } else if(dir == 6) {
-            if(last_dir != 4) {
-                x+=8;
-                last_dir = dir;
-            } else
-                x-=8;
-        } else if(dir == 5) {
-            if(last_dir != 1) {
-                y+=8;
-                last_dir = dir;
-            } else
-                y-=8;
-        } else if(dir == 4) {
-            if(last_dir != 6) {
-                x-=8;
-                last_dir = dir;
-            } else
-                x+=8;
-        }
+//Score digits of a player, four characters apart
+void drawScore(int player)
+{
+    int points = game.snakes[player].points;
+    int x = 9*8 + player*4*8;
 
+    tiles.draw(TILE_DIGIT + points%10, x, 8);
+    if(points > 9) {
+        tiles.draw(TILE_DIGIT + (points/10)%10, x - 8, 8);
+    }
+}
 
+//Redraw the whole field, or check it when verifying
+void redraw(bool clear)
+{
+    const SnakeBody *bodies[GAME_MAX_SNAKES];
+    for(int i = 0; i < game.players; i++)
+        bodies[i] = &game.snakes[i].body;
+    renderer.resync(bodies, game.players, game.foodx, game.foody, clear);
+}
 
-        //add new head to the front
-        snakes.push_front(snake(x, y, 8, GREEN));
-        snake head = snakes.front();
+//Bring the screen to the game after the link set it back and ran it again
+void repair()
+{
+    const SnakeBody *bodies[GAME_MAX_SNAKES];
+    for(int i = 0; i < game.players; i++)
+        bodies[i] = &game.snakes[i].body;
+    renderer.repair(bodies, game.players, game.foodx, game.foody);
+    for(int i = 0; i < game.players; i++)
+        drawScore(i);
+}
 
-        if( x == (foodx*8)-1 && y == (foody*8)-1) {//if new head location is an apple
-            foodx = (rand() % 73) + 2;  //generate a new one and add points
-            foody = (rand() % 52) + 4;
-            vga.rectangle((foodx*8)-1, (foody*8)-1 ,(foodx*8)+7, (foody*8)+7, RED);
+int drifted()
+{
+    const SnakeBody *bodies[GAME_MAX_SNAKES];
+    for(int i = 0; i < game.players; i++)
+        bodies[i] = &game.snakes[i].body;
+    return renderer.verify(bodies, game.players, game.foodx, game.foody);
+}
 
-            //adjust score
-            points++;
-            vga.rectangle(8*8-1, 7, 10*8-1, 15, BLACK);
-            vga.text_char(digit[points%10], 9, 1, WHITE);
-            if(points > 9) {
-                vga.text_char(digit[(points/10)%10], 8, 1, WHITE);
-            }
-            head.draw();    //draw new head leaving tail in place
-        } else {
-            snakes.back().undraw();         //remove tail piece because snake doesnt grow this frame
-            head.draw();
-            snakes.pop_back();              //if we havent aten an apple this frame we must remove the tail of the snake
+//Move the snakes one cell and queue the drawing
+void tickTask(void *)
+{
+#if LINK_PLAY
+    //the link records the agreed game; a rollback since the last tick is
+    //drawn from the game as it is now, this tick included
+    int events = linkplay.tick(game);
+    controllers.frame();
+    if(link_rewound || events < 0) {
+        if(link_rewound)
+            repair();
+        link_rewound = false;
+        sched.signal(submit_task);
+        return;
+    }
+#else
+    if(demo) {
+        for(int i = 0; i < game.players; i++) {
+            int heading = autopilot.choose(game, i);
+            if(heading != game.snakes[i].heading && game.turn(i, heading))
+                replay.turn(i, heading);
         }
+    }
 
-        //Collision with border "death"
-        if( x <= 8 || x >= 615 || y <= 24 || y >= 455)
-            quit = true;
+    int events = game.tick();
+    replay.tick();
+    if(demo)
+        autopilot.update(game);
+    controllers.frame();
+#endif
+
+    //tails first, a head may have moved into a cell another tail left
+    for(int i = 0; i < game.players; i++) {
+        const Snake &s = game.snakes[i];
+        if(s.tailx >= 0)
+            renderer.cell(s.tailx, s.taily, BLACK);   //remove tail piece because snake doesnt grow this frame
+    }
+    for(int i = 0; i < game.players; i++) {
+        const Snake &s = game.snakes[i];
+        if(s.events & GAME_ATE)
+            drawScore(i);
+        if(s.tailx >= 0 || (s.events & GAME_ATE))
+            renderer.head(i, s.body.headX(), s.body.headY(), s.heading);
+    }
+    if((events & GAME_ATE) && game.foodx >= 0)
+        renderer.apple(game.foodx, game.foody);
 
-        //Check for collision with self
-        for(it = snakes.begin(); it != snakes.end(); it++) {
-            if( (*it).y == y && (*it).x == x && it != snakes.begin() )
-                quit = true; 
-        }
+    //redraw everything if the screen no longer matches the game
+    if(drifted())
+        redraw(true);
 
-        //force roughly 15 fps by waiting to process next frame
-        do {        } while( timer.read_ms() < 16.5);
+    ticker++;
+    sched.signal(submit_task);
+}
 
-        //increment frame counter
-        ticker++;
-        //grab direction or keep last direction
-        dir = keyint();
+//Send the frame, its ACKs are collected by ackTask
+void submitTask(void *)
+{
+    renderer.flush();
+}
+
+int submitDepth(void *)
+{
+    return renderer.rects().depth();
+}
+
+void ackTask(void *)
+{
+    vga.poll_acks();
+}
+
+int ackDepth(void *)
+{
+    return vga.pending();
+}
+
+#if LINK_PLAY
+//Take the other board's inputs, rolling the game back when they differ
+//from what was predicted
+void linkTask(void *)
+{
+    if(linkplay.poll(game))
+        link_rewound = true;
+}
+
+int linkDepth(void *)
+{
+    return (link_rx_head - link_rx_tail + LINK_RX_BUFFER) % LINK_RX_BUFFER;
+}
 
+//Wait for the other board, the link then resets the game from the seed
+//they agree on
+void connectLink()
+{
+    vga.graphic_string("Waiting for the other board", 212, 236, FONT_8X8, WHITE, 1, 1);
+    linkplay.begin(time(NULL) ^ us_ticker_read(), &replay);
+    while(!linkplay.connected()) {
+        linkplay.poll(game);
+        linkplay.idle();
+        wait_ms(20);
+    }
+    vga.rectangle(212, 236, 428, 244, BLACK);
+}
+#endif
+
+//Dim the screen and sleep until a hand comes near a keypad, then bring
+//touch sensing and the backlight back
+void idle()
+{
+    vga.display_control(BACKLIGHT, 0x00);
+
+    //reading the status releases IRQ, so the next edge is a new one
+    for(int p = 0; p < controllers.players(); p++) {
+        controllers.chip(p)->setProximityMode(true);
+        controllers.chip(p)->readTouchData();
+    }
+    woke = false;
+
+    //the line is already low when a chip changed status since its read
+    while(!woke && interrupt.read())
+        sleep();
+    if(!woke) {
+        woke_us = us_ticker_read();
+        woke = true;
+    }
+
+    for(int p = 0; p < controllers.players(); p++) {
+        controllers.chip(p)->setProximityMode(false);
+        controllers.chip(p)->readTouchData();
+    }
+    vga.display_control(BACKLIGHT, 0x01);
+
+    wake_us = us_ticker_read() - woke_us;
+    if(wake_us > wake_max_us)
+        wake_max_us = wake_us;
+    if(wake_us > IDLE_WAKE_BUDGET_US)
+        wake_overruns++;
+    printf("wake %d us, %d us max, %d over %d us\n",
+           wake_us, wake_max_us, wake_overruns, IDLE_WAKE_BUDGET_US);
+}
+
+//Keep the last game on the mbed's drive for tools/replay, or print it in hex
+//on the USB serial port when the drive cannot be written
+void saveReplay()
+{
+    FILE *f = fopen("/local/LAST.RPL", "wb");
+    if(f) {
+        fwrite(replay.data(), 1, replay.size(), f);
+        fclose(f);
+    } else {
+        printf("replay ");
+        for(int i = 0; i < replay.size(); i++)
+            printf("%02x", replay.data()[i]);
+        printf("\n");
+    }
+    printf("replay %d bytes, %d ticks, %d turns%s\n", replay.size(), replay.ticks,
+           replay.turns, replay.truncated() ? ", cut short" : "");
+}
+
+//Where the RAM goes: each bank's objects and what is left, the deepest
+//stack and operator new calls
+void memoryReport()
+{
+    uint32_t statics = staticEnd() - RAM_MAIN_BASE;
+    uint32_t heap = heapEnd() - staticEnd();
+    uint32_t floor = stackTop() - STACK_BUDGET;
+    printf("ram local: %d statics (display %d, keypads %d, scheduler %d), %d heap, "
+           "%d free below the stack\n", (int)statics, (int)sizeof(vga),
+           (int)(sizeof(i2c) + sizeof(controllers) + sizeof(decoders)), (int)sizeof(sched),
+           (int)heap, (int)(floor - heapEnd()));
+    printf("ram stack: %d deepest of %d\n", stackDeepest(), STACK_BUDGET);
+    printf("ram ahbsram0: autopilot %d, %d free\n", (int)sizeof(autopilot),
+           RAM_AHB_SIZE - (int)sizeof(autopilot));
+    printf("ram ahbsram1: replay %d, game %d, renderer %d, %d free\n", (int)sizeof(replay),
+           (int)sizeof(game), (int)sizeof(renderer),
+           RAM_AHB_SIZE - (int)(sizeof(replay) + sizeof(game) + sizeof(renderer)));
+    printf("operator new %d calls since power up\n", heapAllocs);
+}
+
+//Per task runtime, queue depths and stack, on the USB serial port
+void report()
+{
+    printf("\ntask      runs  late  avg us  max us  avg depth  max depth  stack\n");
+    for(int i = 0; i < sched.count(); i++) {
+        const Scheduler::Task &t = sched.task(i);
+        int runs = t.runs ? t.runs : 1;
+        printf("%-8s %6d %5d %7d %7d %10d %10d %6d\n", t.name, t.runs, t.late,
+               (int)(t.total_us / runs), (int)t.max_us, t.sum_depth / runs, t.max_depth,
+               t.max_stack);
+    }
+    printf("steps %d, idle %d, acks %d, ack window stalls %d\n",
+           sched.steps, sched.idle, vga.acked, vga.ack_stalls);
+    printf("display %d timeouts, %d garbled, %d late, %d resyncs (%d failed), %d ms worst stall\n",
+           vga.reply_timeouts, vga.reply_errors, vga.late_replies, vga.resyncs,
+           vga.resync_failures, vga.max_stall_ms);
+    printf("i2c %d transfers, %d nacks, %d bus errors, %d queue full\n",
+           i2c.completed, i2c.nacks, i2c.busErrors, i2c.overflows);
+    printf("i2c %d kHz, transfer %d us average, %d us max\n",
+           mpr121.getFrequency() / 1000, mpr121.averageLatency(), mpr121.maxLatency());
+    printf("%d keypads, %d reads (%d on irq), %d deferred, %d dropped, %d failed\n",
+           controllers.players(), controllers.reads, controllers.irqReads,
+           controllers.deferred, controllers.dropped, controllers.failed);
+    printf("turns %d queued, %d dropped as repeats or reversals, %d lost to a full queue\n",
+           game.turnsQueued, game.turnsDropped, game.turnsLost);
+#if LINK_PLAY
+    printf("link %d ticks, %d agreed, %d rollbacks (%d ticks again, %d most), %d stalls\n",
+           linkplay.ticks, linkplay.confirmedTicks, linkplay.rollbacks, linkplay.resimulated,
+           linkplay.maxRollback, linkplay.stalls);
+    printf("link %d packets sent, %d received, %d bad, %d of %d checksums differ\n",
+           linkplay.sent, linkplay.received, linkplay.badPackets, linkplay.desyncs,
+           linkplay.checks);
+#endif
+    if(demo)
+        printf("autopilot %d searches (%d for costly updates), %d unsafe moves, %d cells %d max\n",
+               autopilot.rebuilds, autopilot.overflows, autopilot.unsafe,
+               autopilot.lastCells, autopilot.maxCells);
+    for(int p = 0; p < controllers.players(); p++) {
+        const TouchDecoder &d = decoders[p];
+        printf("keypad %d: %d events, %d early presses, %d dropped, decode %d us max\n",
+               p, d.events, d.earlyPresses, d.dropped, d.maxUs);
     }
+    memoryReport();
+}
+
+
+int main()
+{
+    //the stack budget is painted first, to measure what the tasks use
+    stackPaint();
+
+    //display handshake is done by the constructor, already at 115200
+    
+    //added - Set Display to 640 by 480 mode, the driver takes its size from it
+    vga.batch_begin();
+    vga.display_control(RESOLUTION, RES_640X480);
+    vga.background_color(BLACK);
+    vga.set_font(FONT_8X8);
+    vga.text_mode(TRANSPARENT);
+    vga.batch_end();
+
+    //run the touch controller as fast as the bus allows, then time reads afresh
+    mpr121.autoFrequency(400000);
+    i2c.resetLatency();
+
+    //other keypads on the bus, all read on touch interrupts
+    controllers.attach(&mpr121);
+    controllers.scan();
+    //early touches need 42 byte reads, only one keypad fits the frame budget with them
+    controllers.readElectrodeData(controllers.players() == 1);
+    interrupt.fall(&touchIrq);
+
+    //input first so a key pressed during a frame is seen by the next tick
+    sched.add("input", inputTask, 0, 2000, inputDepth);
+#if LINK_PLAY
+    link_uart.baud(LINK_BAUD);
+    link_uart.attach(&linkRx);
+    sched.add("link", linkTask, 0, 1000, linkDepth);
+#endif
+    sched.add("tick", tickTask, 0, 16500);
+    submit_task = sched.add("submit", submitTask, 0, 0, submitDepth);
+    sched.add("ack", ackTask, 0, 1000, ackDepth);
+    sched.stackProbe(stackProbe);
+
+    //Restart entry point
+restart:
+
+    vga.cls();
+    tiles.invalidate();
+    tiles.preload();
+    renderer.invalidate();
+
+#if LINK_PLAY
+    //a snake per board, from the other board's seed or this one's
+    connectLink();
+    link_rewound = false;
+#else
+    //a snake per keypad heading right and first apple, from a seed the
+    //replay keeps
+    game.reset(controllers.players(), time(NULL) ^ us_ticker_read());
+    replay.start(game);
+#endif
+    for(int i = 0; i < GAME_MAX_SNAKES; i++)
+        last_key[i] = 0;
+    if(demo)
+        autopilot.reset(game);
+    demo_quit = false;
+
+    //set up score
+    vga.text_string("SCORE:", 2, 1, FONT_8X8, WHITE);
+    for(int i = 0; i < game.players; i++)
+        drawScore(i);
+
+    //set frame ticker
+    ticker = 0;
+
+    //draw field, first apple and beginning snakes
+    redraw(false);
+    renderer.flush();
+    if(first_frame_ms == 0)
+        first_frame_ms = vga.boot_elapsed_ms();
+
+    //run the tasks until the snake dies, with display ACKs read in the
+    //background; everything they use is static, the heap stays locked
+    sched.resetStats();
+    stackProbe();
+    heapLock(true);
+    vga.batch_begin();
+#if LINK_PLAY
+    //until both boards agree the game is over, or the other one is gone
+    while( !linkplay.finished() && linkplay.waiting < LINK_GIVE_UP )
+        sched.step();
+    game = linkplay.agreed();
+    repair();
+    renderer.flush();
+#else
+    while( !game.over && !demo_quit )
+        sched.step();
+#endif
+    vga.batch_end();
+    heapLock(false);
+    replay.finish(game);
+    report();
+    saveReplay();
+
+    //a touch during a demo starts a real game, a soak test just goes on
+    if(demo_quit) {
+        demo = false;
+        goto restart;
+    }
+    if(SOAK_TEST)
+        goto restart;
+
     //ENDGAME
     //clear background for text displays
     vga.rectangle(183,223,455,255, BLACK);
 
-    vga.graphic_string("You Lost The Game", 183, 223, FONT_8X8, WHITE, 2,2);
+    const char *end = demo ? "    Game Over    " : "You Lost The Game";
+#if LINK_PLAY
+    end = game.over ? "    Game Over    " : "    Link Lost    ";
+#endif
+    vga.graphic_string(end, 183, 223, FONT_8X8, WHITE, 2,2);
     vga.graphic_string("SCORE",247,239, FONT_8X8, WHITE, 2, 2);
 
-    //print final points
+    //print final points, of the last snake standing in a game for several
+    int winner = 0;
+    for(int i = 0; i < game.players; i++)
+        if(game.snakes[i].alive)
+            winner = i;
+    int points = game.snakes[winner].points;
+    if(game.players > 1) {
+        vga.graphic_char('P', 183, 239, WHITE, 2, 2);
+        vga.graphic_char(digit[winner + 1], 199, 239, WHITE, 2, 2);
+    }
     vga.graphic_char(digit[points%10], 362, 239, WHITE, 2, 2);
     if(points > 9) {
         vga.graphic_char(digit[(points/10)%10], 343 , 239, WHITE, 2, 2);
     }
 
 
-    //flash prompt to user for restart
-    dir = 0;
+    //flash prompt to user for restart, show a demo game then idle when
+    //nobody is playing
+    int dir = 0;
+    int flashes = 0;
     while( dir != 5) {
+        if(flashes++ == IDLE_AFTER_S) {
+            if(!demo && !LINK_PLAY) {
+                demo = true;
+                goto restart;
+            }
+            idle();
+            demo = false;
+            flashes = 0;
+        }
         wait(.5);
         vga.rectangle(248,400,392,408, BLACK);
         wait(.5);
         dir = keyint();
         vga.graphic_string("Hold 5 To Restart", 248, 400, FONT_8X8, WHITE, 1, 1);
     }
-    //if restart, force erase of snake list elements
-    snakes.erase(snakes.begin(), snakes.end());
+    demo = false;
     goto restart;
 
     return 0;
@@ -218,8 +640,12 @@ void snake::undraw(void)//Overdraw snake part with background
 
 int keyint() //check for input on MPR121
 {
-    int value=mpr121.read(0x00); // LED demo mod by J. Hamblen
+    return keycode(mpr121.read(0x00)); // LED demo mod by J. Hamblen
+}
+
 
+int keycode(int value) //keypad code for a touch status byte
+{
     //switch to return player input
     switch (value) {
         case 0x40://move right button 6
@@ -0,0 +1,105 @@
+#include <new>
+#include "mbed.h"
+#include "memplan.h"
+
+// End of the statics in the local bank, from the linker
+#if defined(__ARMCC_VERSION)
+extern char Image$$RW_IRAM1$$ZI$$Limit[];
+#define STATIC_END      Image$$RW_IRAM1$$ZI$$Limit
+#else
+extern char __end__[];
+#define STATIC_END      __end__
+#endif
+
+static volatile bool heapLocked;
+volatile int heapAllocs;
+
+void heapLock(bool locked)
+{
+    heapLocked = locked;
+}
+
+void *operator new(size_t size)
+{
+    heapAllocs++;
+    if (heapLocked)
+        error("operator new of %d bytes while the heap is locked\n", (int)size);
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        error("operator new of %d bytes, out of memory\n", (int)size);
+    return p;
+}
+
+void *operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p)
+{
+    free(p);
+}
+
+void operator delete[](void *p)
+{
+    free(p);
+}
+
+uint32_t stackTop()
+{
+    //first word of the vector table, also in the copy mbed moves to RAM
+    return ((const uint32_t *)SCB->VTOR)[0];
+}
+
+uint32_t staticEnd()
+{
+    return (uint32_t)STATIC_END;
+}
+
+uint32_t heapEnd()
+{
+    //the next block malloc hands out is past the heap in use, unless a
+    //freed hole fits it; close enough for a report
+    void *p = malloc(sizeof(int));
+    free(p);
+    return p ? (uint32_t)p + sizeof(int) : staticEnd();
+}
+
+static uint32_t *stackFloor()
+{
+    return (uint32_t *)(stackTop() - STACK_BUDGET);
+}
+
+void stackPaint()
+{
+    uint32_t *sp = (uint32_t *)__get_MSP();
+    for (uint32_t *p = stackFloor(); p < sp; p++)
+        *p = STACK_PAINT;
+}
+
+int stackProbe()
+{
+    uint32_t *floor = stackFloor();
+    uint32_t *sp = (uint32_t *)__get_MSP();
+
+    //down from here to the first run of paint, then paint what was used
+    uint32_t *p = sp;
+    int run = 0;
+    while (p > floor && run < STACK_RUN) {
+        p--;
+        run = *p == STACK_PAINT ? run + 1 : 0;
+    }
+    uint32_t *used = p + run;
+    for (p = used; p < sp; p++)
+        *p = STACK_PAINT;
+    return stackTop() - (uint32_t)used;
+}
+
+int stackDeepest()
+{
+    uint32_t *sp = (uint32_t *)__get_MSP();
+    uint32_t *p = stackFloor();
+    while (p < sp && *p == STACK_PAINT)
+        p++;
+    return stackTop() - (uint32_t)p;
+}
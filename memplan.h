@@ -0,0 +1,62 @@
+#ifndef MEMPLAN_H
+#define MEMPLAN_H
+
+#include <stdint.h>
+
+// RAM of the LPC1768: the local bank holds the statics, the heap above
+// them and the stack at the top; the two AHB banks only what is put there
+#define RAM_MAIN_BASE   0x10000000
+#define RAM_MAIN_SIZE   0x8000
+#define RAM_AHB_SIZE    0x4000
+
+// Stack the program may use, painted at boot and measured against
+#define STACK_BUDGET    4096
+// Word unused stack is painted with
+#define STACK_PAINT     0xC5C5C5C5u
+// Painted words in a row that end the used part of the stack below a task
+#define STACK_RUN       8
+
+// Puts a static object in an AHB SRAM bank. Not every toolchain clears
+// the banks with the statics, so only objects set up by a constructor go
+// there.
+#if defined(TARGET_LPC1768)
+#define IN_AHBSRAM0     __attribute__((section("AHBSRAM0")))
+#define IN_AHBSRAM1     __attribute__((section("AHBSRAM1")))
+#else
+#define IN_AHBSRAM0
+#define IN_AHBSRAM1
+#endif
+
+// Stops the build when a condition on sizes is false, e.g.
+//   MEM_CHECK(sizeof(Autopilot) <= RAM_AHB_SIZE, autopilot_fits);
+#define MEM_CHECK(cond, name)   typedef char mem_check_##name[(cond) ? 1 : -1]
+
+// Memory plan.
+//
+// Every structure the game runs on is a static object of fixed size, in a
+// bank chosen for it, so the RAM it needs is known when it links and
+// nothing can fragment. The heap is left to the C library and to start-up.
+//
+// Heap guard: operator new is counted, and while the heap is locked it
+// stops the program through error(), naming the size asked for. main()
+// locks it around the game loop.
+//
+// Stack monitor: the stack budget below the boot stack pointer is painted
+// once. stackProbe() finds how deep the stack went below the caller since
+// the last probe and paints that part again, which costs about the depth
+// used; the scheduler calls it after each task. A local array left
+// unwritten over STACK_RUN words can hide what is below it from a probe,
+// never from stackDeepest(), which scans up from the bottom.
+void heapLock(bool locked);
+extern volatile int heapAllocs;     // operator new calls since power up
+
+void stackPaint();
+int  stackProbe();          // bytes below the stack top at the deepest since the last probe
+int  stackDeepest();        // the same since the paint
+
+// Addresses of the local bank, for the report
+uint32_t stackTop();
+uint32_t staticEnd();       // first byte after the statics, where the heap starts
+uint32_t heapEnd();         // first byte past the heap in use
+
+#endif
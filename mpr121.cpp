@@ -20,18 +20,15 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 THE SOFTWARE.
 */
 
-#include <mbed.h>
-#include <sstream>
-#include <string>
-#include <list>
-
 #include <mpr121.h>
     
-Mpr121::Mpr121(I2C *i2c, Address i2cAddress)
+Mpr121::Mpr121(I2cQueue *i2c, Address i2cAddress)
 {
     this->i2c = i2c;
     
     address = i2cAddress;
+    error = I2C_OK;
+    errors = 0;
            
     // Configure the MPR121 settings to default
     this->configureSettings();
@@ -120,84 +117,125 @@ void Mpr121::setElectrodeThreshold(int electrode, unsigned char touch, unsigned
 }
     
     
+int Mpr121::check(int status){
+    error = status;
+    if(status != I2C_OK)
+        errors++;
+    return status;
+}
+
+
 unsigned char Mpr121::read(int key){
 
-    unsigned char data[2];
+    unsigned char data[1] = {0};
+
+    // Register read with a repeated start, queued behind any async transfer
+    if(check(i2c->readSync(address, key, data, 1)) != I2C_OK)
+        return 0;
+
+    return data[0];
+}
+
+
+int Mpr121::write(int key, unsigned char value){
     
-    //Start the command
-    i2c->start();
+    return check(i2c->writeSync(address, key, &value, 1));
+}
 
-    // Address the target (Write mode)
-    int ack1= i2c->write(address);
 
-    // Set the register key to read
-    int ack2 = i2c->write(key);
+int Mpr121::writeMany(int start, unsigned char* dataSet, int length){
 
-    // Re-start for read of data
-    i2c->start();
+    int count = 0;
 
-    // Re-send the target address in read mode
-    int ack3 = i2c->write(address+1);
+    // Split into transfers the queue can hold
+    while(count < length){
+        int n = length - count;
+        if(n > I2C_DATA_MAX)
+            n = I2C_DATA_MAX;
+        if(check(i2c->writeSync(address, start + count, dataSet + count, n)) != I2C_OK)
+            return error;
+        count += n;
+    }
+    
+    return count;
+}
 
-    // Read in the result
-    data[0] = i2c->read(0); 
 
-    // Reset the bus        
-    i2c->stop();
+bool Mpr121::readAsync(int key, unsigned char *data, int length, I2cQueue::Done done, void *ctx){
+    return i2c->read(address, key, data, length, done, ctx);
+}
 
-    return data[0];
+
+bool Mpr121::writeAsync(int key, const unsigned char *data, int length, I2cQueue::Done done, void *ctx){
+    return i2c->write(address, key, data, length, done, ctx);
 }
+      
 
+// Bus speeds tried by autoFrequency(), fastest first
+static const int busSpeeds[] = { 400000, 200000, 100000 };
 
-int Mpr121::write(int key, unsigned char value){
-    
-    //Start the command
-    i2c->start();
+// Register reads per speed before it is trusted
+#define BUS_CHECKS 4
 
-    // Address the target (Write mode)
-    int ack1= i2c->write(address);
 
-    // Set the register key to write
-    int ack2 = i2c->write(key);
+void Mpr121::setFrequency(int hz){
+    i2c->frequency(hz);
+}
 
-    // Read in the result
-    int ack3 = i2c->write(value); 
 
-    // Reset the bus        
-    i2c->stop();
-    
-    return (ack1+ack2+ack3)-3;
+int Mpr121::getFrequency(){
+    return i2c->frequency();
 }
 
 
-int Mpr121::writeMany(int start, unsigned char* dataSet, int length){
-    //Start the command
-    i2c->start();
+bool Mpr121::checkBus(){
 
-    // Address the target (Write mode)
-    int ack= i2c->write(address);
-    if(ack!=1){
-        return -1;
+    unsigned char data[24];
+
+    for(int n = 0; n < BUS_CHECKS; n++){
+        // All electrode thresholds in one burst, then the filter setting
+        if(check(i2c->readSync(address, ELE0_T, data, 24)) != I2C_OK)
+            return false;
+        for(int i = 0; i < 24; i += 2){
+            if(data[i] != E_THR_T || data[i+1] != E_THR_R)
+                return false;
+        }
+        if(read(FIL_CFG) != 0x04 || error != I2C_OK)
+            return false;
     }
-    
-    // Set the register key to write
-    ack = i2c->write(start);
-    if(ack!=1){
-        return -1;
+    return true;
+}
+
+
+int Mpr121::autoFrequency(int maxHz){
+
+    for(unsigned int i = 0; i < sizeof(busSpeeds)/sizeof(busSpeeds[0]); i++){
+        if(busSpeeds[i] > maxHz)
+            continue;
+        setFrequency(busSpeeds[i]);
+        if(checkBus())
+            return busSpeeds[i];
     }
 
-    // Write the date set
-    int count = 0;
-    while(ack==1 && (count < length)){
-        ack = i2c->write(dataSet[count]);
-        count++;
-    } 
-    // Stop the cmd
-    i2c->stop();
-    
-    return count;
+    setFrequency(100000);
+    return 0;
 }
-      
+
+
+int Mpr121::lastLatency(){
+    return i2c->lastUs();
+}
+
+
+int Mpr121::maxLatency(){
+    return i2c->maxUs();
+}
+
+
+int Mpr121::averageLatency(){
+    return i2c->averageUs();
+}
+
 
 bool Mpr121::getProximityMode(){
     if(this->read(ELE_CFG) > 0x0c)
@@ -217,5 +255,11 @@ void Mpr121::setProximityMode(bool mode){
 
 
 int Mpr121::readTouchData(){
-    return this->read(0x00);
+
+    unsigned char data[2] = {0, 0};
+
+    if(check(i2c->readSync(address, 0x00, data, 2)) != I2C_OK)
+        return -1;
+
+    return data[0] | ((data[1] & 0x1F) << 8);
 }
\ No newline at end of file
@@ -27,6 +27,8 @@ THE SOFTWARE.
 #ifndef MPR121_H
 #define MPR121_H
 
+#include "i2cqueue.h"
+
 //using namespace std;
 
 class Mpr121 
@@ -41,19 +43,54 @@ public:
                  };
 
     // Real initialiser, takes the i2c address of the device.
-    Mpr121(I2C *i2c, Address i2cAddress);
+    Mpr121(I2cQueue *i2c, Address i2cAddress);
     
+    Address getAddress() { return address; }
+
     bool getProximityMode();
     
+    // Proximity mode senses all 12 pads as one electrode and sets
+    // PROXIMITY_STATUS instead of the touch bits, at a fraction of the
+    // scanning work. Touch mode is the normal 12 electrode keypad.
     void setProximityMode(bool mode);
     
+    // Both status registers, which also releases IRQ: bit n for electrode
+    // n touched, PROXIMITY_STATUS when a hand is near. -1 on a failed read.
     int readTouchData();
                
+    // Blocking register access. read() returns 0 on a failed transfer, see
+    // error for why; write() returns 0 or an I2C_ error; writeMany() returns
+    // the number of bytes written or an I2C_ error.
     unsigned char read(int key);
     
     int write(int address, unsigned char value);
     int writeMany(int start, unsigned char* dataSet, int length);
 
+    // Queued register access, done(ctx, status) is called from the I2C
+    // interrupt once data has been read. Returns false when the queue is full.
+    bool readAsync(int key, unsigned char *data, int length, I2cQueue::Done done, void *ctx);
+    bool writeAsync(int key, const unsigned char *data, int length, I2cQueue::Done done = 0, void *ctx = 0);
+
+    // Bus speed, up to 400 kHz Fast-mode
+    void setFrequency(int hz);
+    int getFrequency();
+
+    // Try the bus speeds up to maxHz, fastest first, and keep the first one
+    // that reads the configured registers back intact. Returns the speed
+    // kept, or 0 when none worked and the bus was left at 100 kHz.
+    int autoFrequency(int maxHz = 400000);
+
+    // Bus time of the last transaction, the longest and the average, in us
+    int lastLatency();
+    int maxLatency();
+    int averageLatency();
+
+    // Status of the last blocking transfer, I2C_OK or an I2C_ error
+    int error;
+
+    // Blocking transfers that failed
+    int errors;
+
     void setElectrodeThreshold(int electrodeId, unsigned char touchThreshold, unsigned char releaseThreshold);
         
 protected:
@@ -61,8 +98,14 @@ protected:
     void configureSettings();
     
 private:
+    // Track the status of a blocking transfer
+    int check(int status);
+
+    // Read back the registers set by configureSettings()
+    bool checkBus();
+
     // The I2C bus instance.
-    I2C *i2c;
+    I2cQueue *i2c;
 
     // i2c address of this mpr121
     Address address;
@@ -130,6 +173,9 @@ private:
 // Electrode configuration - transistions to "active mode"
 #define    ELE_CFG      0x5E
 
+// Proximity electrode bit of readTouchData()
+#define    PROXIMITY_STATUS 0x1000
+
 #define GPIO_CTRL0      0x73
 #define GPIO_CTRL1      0x74
 #define GPIO_DATA       0x75
@@ -0,0 +1,155 @@
+#include <string.h>
+#include "i2cqueue.h"
+
+#if I2C_QUEUE_HOST
+
+#include "mpr121sim.h"
+
+Mpr121Sim::Mpr121Sim(int address)
+{
+    this->address = address & 0xFE;
+    memset(regs, 0, sizeof(regs));
+    regs[0x5C] = 0x10;  //AFE_CFG reset value
+    regs[0x5D] = 0x24;  //FIL_CFG reset value
+    nackAddress = 0;
+    nackData = 0;
+    reads = 0;
+    writes = 0;
+    touch(0);
+}
+
+void Mpr121Sim::touch(int mask)
+{
+    regs[0x00] = mask & 0xFF;
+    regs[0x01] = (mask >> 8) & 0x1F;
+    for (int e = 0; e < 13; e++) {
+        //10 bit filtered data, baseline register holds its top 8 bits
+        int filtered = ((mask >> e) & 1) ? 0x100 : 0x200;
+        regs[0x04 + 2 * e] = filtered & 0xFF;
+        regs[0x05 + 2 * e] = filtered >> 8;
+        regs[0x1E + e] = 0x200 >> 2;
+    }
+}
+
+I2cSim::I2cSim()
+{
+    for (int i = 0; i < I2C_SIM_DEVICES; i++)
+        devices[i] = 0;
+    selected = 0;
+    active = false;
+    addressing = false;
+    pointing = false;
+    reading = false;
+    pointer = 0;
+    value = 0;
+    hasStat = false;
+    busError = 0;
+    stuck = false;
+    maxHz = 0;
+    us = 0;
+    hz = 100000;
+}
+
+void I2cSim::attach(Mpr121Sim *device)
+{
+    for (int i = 0; i < I2C_SIM_DEVICES; i++) {
+        if (!devices[i]) {
+            devices[i] = device;
+            return;
+        }
+    }
+}
+
+void I2cSim::clock(int bits)
+{
+    us += (bits * 1000000L + hz - 1) / hz;
+}
+
+bool I2cSim::next(int *stat)
+{
+    if (stuck) {
+        clock(1);       //SCL held low, time passes with nothing to show
+        return false;
+    }
+    if (!hasStat)
+        return false;
+    hasStat = false;
+    *stat = this->stat;
+    return true;
+}
+
+void I2cSim::start()
+{
+    clock(1);
+    stat = active ? 0x10 : 0x08;
+    hasStat = true;
+    active = true;
+    addressing = true;
+}
+
+void I2cSim::send(int c)
+{
+    clock(9);
+    hasStat = true;
+
+    if (busError) {
+        busError--;
+        stat = 0x00;
+        return;
+    }
+
+    if (addressing) {
+        addressing = false;
+        reading = c & 1;
+        selected = 0;
+        for (int i = 0; i < I2C_SIM_DEVICES; i++)
+            if (devices[i] && devices[i]->address == (c & 0xFE))
+                selected = devices[i];
+        if (selected && selected->nackAddress) {
+            selected->nackAddress--;
+            selected = 0;
+        }
+        if (!reading)
+            pointing = true;
+        stat = reading ? (selected ? 0x40 : 0x48) : (selected ? 0x18 : 0x20);
+        return;
+    }
+
+    if (selected && selected->nackData) {
+        selected->nackData--;
+        stat = 0x30;
+        return;
+    }
+    if (pointing) {
+        pointing = false;
+        pointer = c & 0x7F;
+    } else if (selected) {
+        selected->regs[pointer] = c;
+        selected->writes++;
+        pointer = (pointer + 1) & 0x7F;
+    }
+    stat = 0x28;
+}
+
+void I2cSim::receive(bool ack)
+{
+    clock(9);
+    value = selected ? selected->regs[pointer] : 0xFF;
+    if (maxHz && hz > maxHz)
+        value ^= 0x01;
+    if (selected)
+        selected->reads++;
+    pointer = (pointer + 1) & 0x7F;
+    stat = ack ? 0x50 : 0x58;
+    hasStat = true;
+}
+
+void I2cSim::stop()
+{
+    if (active)
+        clock(1);
+    active = false;
+    hasStat = false;
+}
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef MPR121SIM_H
+#define MPR121SIM_H
+
+// Host simulation of an I2C bus with MPR121 chips on it, used by I2cQueue
+// when built with I2C_QUEUE_HOST.
+
+// Chips on one simulated bus
+#define I2C_SIM_DEVICES     4
+
+// Register file of one MPR121
+class Mpr121Sim
+{
+public:
+    // address is the 8 bit write address, e.g. Mpr121::ADD_VSS
+    Mpr121Sim(int address);
+
+    // Set the touched electrodes, bit 0 for electrode 0. Filtered data
+    // drops below the baseline on touched electrodes like on the chip.
+    void touch(int mask);
+
+    int address;
+    unsigned char regs[0x80];
+
+    // Fault injection, each counts down once per byte it affects
+    int nackAddress;    // refuse the next address bytes
+    int nackData;       // refuse the next written data bytes
+
+    // Statistics
+    int reads;          // register bytes read
+    int writes;         // register bytes written
+};
+
+// Bus shared by the simulated chips. It reports the same state codes as
+// the LPC17xx I2C controller and keeps time from the bits clocked.
+class I2cSim
+{
+public:
+    I2cSim();
+
+    void attach(Mpr121Sim *device);
+
+    // Bus clock, 100 kHz by default
+    void frequency(int hz) { this->hz = hz; }
+
+    // Controller side, used by I2cQueue
+    void start();
+    void send(int c);
+    void receive(bool ack);
+    void stop();
+    int  data() const { return value; }
+
+    // Next state code, false when the bus is idle
+    bool next(int *stat);
+
+    // Fault injection: the next byte ends in a bus error
+    int busError;
+
+    // Fault injection: a chip holds SCL low, so nothing clocked gets an
+    // answer until this is cleared; time still passes while polled
+    bool stuck;
+
+    // Fastest clock the bus wiring supports; above it received bytes get
+    // corrupted, as with too much capacitance on the lines. 0 for no limit.
+    int maxHz;
+
+    // Simulated time, in us
+    long us;
+    int hz;
+
+private:
+    void clock(int bits);
+
+    Mpr121Sim *devices[I2C_SIM_DEVICES];
+    Mpr121Sim *selected;
+    bool active;        // between a start and a stop
+    bool addressing;    // next byte is an address
+    bool pointing;      // next written byte is a register number
+    bool reading;
+    int pointer;
+    int value;
+
+    int stat;
+    bool hasStat;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include "rectbatch.h"
+
+//rectangle batch constructor
+RectBatch::RectBatch(TFT_4DGL *lcd)
+{
+    this->lcd = lcd;
+    count = 0;
+
+    queued = 0;
+    merged = 0;
+    dropped = 0;
+    sent = 0;
+
+    invalidate();
+}
+
+void RectBatch::invalidate()
+{
+    for (int i = 0; i < RECT_SHADOW_SIZE; i++)
+        shadow[i].color = -1;
+}
+
+void RectBatch::rectangle(int x1, int y1, int x2, int y2, int color)
+{
+    Rect r;
+    r.x1 = x1;
+    r.y1 = y1;
+    r.x2 = x2;
+    r.y2 = y2;
+    r.color = color;
+
+    queued++;
+
+    //replace an earlier write to the same rectangle, unless something
+    //queued after it overlaps and would then be drawn in the wrong order
+    for (int i = count - 1; i >= 0; i--) {
+        if (same(pending[i], r)) {
+            pending[i].color = color;
+            merged++;
+            return;
+        }
+        if (overlaps(pending[i], r))
+            break;
+    }
+
+    if (count == RECT_BATCH_MAX)
+        flush();
+    pending[count++] = r;
+}
+
+// Drop shadow entries with pixels that area changes to another colour.
+// An area colour of -1 means unknown content.
+void RectBatch::forget(const Rect &area)
+{
+    for (int i = 0; i < RECT_SHADOW_SIZE; i++)
+        if (shadow[i].color != -1 && shadow[i].color != area.color && overlaps(shadow[i], area))
+            shadow[i].color = -1;
+}
+
+void RectBatch::flush()
+{
+    for (int i = 0; i < count; i++) {
+        const Rect &r = pending[i];
+        Rect &s = shadow[slot(r)];
+
+        if (s.color == r.color && same(s, r)) {
+            dropped++;
+            continue;
+        }
+
+        lcd->rectangle(r.x1, r.y1, r.x2, r.y2, r.color);
+        sent++;
+
+        forget(r);
+        s = r;
+    }
+    count = 0;
+}
+
+void RectBatch::touch(int x1, int y1, int x2, int y2)
+{
+    Rect area;
+    area.x1 = x1;
+    area.y1 = y1;
+    area.x2 = x2;
+    area.y2 = y2;
+    area.color = -1;
+
+    //queued rectangles under the area must reach the screen first
+    for (int i = 0; i < count; i++) {
+        if (overlaps(pending[i], area)) {
+            flush();
+            break;
+        }
+    }
+    forget(area);
+}
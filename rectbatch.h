@@ -0,0 +1,75 @@
+#ifndef RECTBATCH_H
+#define RECTBATCH_H
+
+#include "TFT_4DGL.h"
+
+// Rectangles held back until the end of the frame
+#define RECT_BATCH_MAX      32
+
+// Entries in the shadow colour map, a power of two
+#define RECT_SHADOW_SIZE    128
+
+// Per-frame coalescer in front of TFT_4DGL::rectangle.
+//
+// Rectangles are queued during a frame and keyed by their exact geometry:
+// only the last colour written to a rectangle is kept. On flush() each one
+// is looked up in a shadow map of the colours already on screen and
+// dropped if it would not change anything.
+//
+// Anything else drawn over the same pixels (blits, text, clears) must be
+// reported with touch() so the shadow map does not go stale.
+class RectBatch
+{
+public:
+    RectBatch(TFT_4DGL *lcd);
+
+    // Queue a filled rectangle
+    void rectangle(int x1, int y1, int x2, int y2, int color);
+
+    // Send the reduced list to the display
+    void flush();
+
+    // Pixels in the area are about to be changed by something else
+    void touch(int x1, int y1, int x2, int y2);
+
+    // Forget everything known about the screen, e.g. after a cls()
+    void invalidate();
+
+    // Rectangles waiting for flush()
+    int depth() const { return count; }
+
+    // Statistics
+    int queued;     // rectangle() calls
+    int merged;     // overwritten by a later colour in the same frame
+    int dropped;    // already on screen, never sent
+    int sent;       // sent to the display
+
+private:
+    struct Rect {
+        short x1, y1, x2, y2;
+        int color;
+    };
+
+    static bool same(const Rect &a, const Rect &b) {
+        return a.x1 == b.x1 && a.y1 == b.y1 && a.x2 == b.x2 && a.y2 == b.y2;
+    }
+    static bool overlaps(const Rect &a, const Rect &b) {
+        return a.x1 <= b.x2 && b.x1 <= a.x2 && a.y1 <= b.y2 && b.y1 <= a.y2;
+    }
+    static int slot(const Rect &r) {
+        return (r.x1 * 7 + r.y1 * 13 + r.x2 * 31 + r.y2 * 61) & (RECT_SHADOW_SIZE - 1);
+    }
+
+    void forget(const Rect &area);
+
+    TFT_4DGL *lcd;
+
+    // this frame's rectangles, in drawing order
+    Rect pending[RECT_BATCH_MAX];
+    int count;
+
+    // direct mapped shadow of colours on screen, color -1 when empty
+    Rect shadow[RECT_SHADOW_SIZE];
+};
+
+#endif
@@ -0,0 +1,341 @@
+#include "renderer.h"
+
+#if RENDER_VERIFY
+// shadow colour codes
+#define SH_BLACK    0
+#define SH_GREEN    1
+#define SH_RED      2
+#define SH_OTHER    3
+#endif
+
+//renderer constructor
+Renderer::Renderer(TFT_4DGL *lcd, TileCache *tiles) : batch(lcd)
+{
+    this->lcd = lcd;
+    this->tiles = tiles;
+
+    for (int i = 0; i < RENDER_MAX_SNAKES; i++)
+        headX[i] = headY[i] = -1;
+    memset(drawn, 0, sizeof(drawn));
+    appleX = appleY = -1;
+
+    commands = 0;
+    resyncs = 0;
+    drift = 0;
+    bodyRects = 0;
+
+#if RENDER_VERIFY
+    memset(shadow, SH_BLACK, sizeof(shadow));
+#endif
+}
+
+void Renderer::rect(int x1, int y1, int x2, int y2, int color)
+{
+    batch.rectangle(x1, y1, x2, y2, color);
+    commands++;
+}
+
+void Renderer::flush()
+{
+    batch.flush();
+}
+
+void Renderer::invalidate()
+{
+    batch.invalidate();
+    for (int i = 0; i < RENDER_MAX_SNAKES; i++)
+        headX[i] = headY[i] = -1;
+    memset(drawn, 0, sizeof(drawn));
+    appleX = appleY = -1;
+#if RENDER_VERIFY
+    memset(shadow, SH_BLACK, sizeof(shadow));
+#endif
+}
+
+void Renderer::setDrawn(int x, int y, int color)
+{
+    if (x < 0 || x >= FIELD_W || y < 0 || y >= FIELD_H)
+        return;
+    if (color == GREEN)
+        drawn[y][x >> 5] |= 1u << (x & 31);
+    else
+        drawn[y][x >> 5] &= ~(1u << (x & 31));
+}
+
+// Fill the cells from (x1,y1) to (x2,y2) inclusive with one command
+void Renderer::run(int x1, int y1, int x2, int y2, int color)
+{
+    if (x1 > x2) { int t = x1; x1 = x2; x2 = t; }
+    if (y1 > y2) { int t = y1; y1 = y2; y2 = t; }
+
+    rect(CELL_PX(x1), CELL_PX(y1), CELL_PX(x2) + CELL_SIZE, CELL_PX(y2) + CELL_SIZE, color);
+
+    for (int y = y1; y <= y2; y++)
+        for (int x = x1; x <= x2; x++)
+            setDrawn(x, y, color);
+
+#if RENDER_VERIFY
+    for (int y = y1; y <= y2; y++)
+        for (int x = x1; x <= x2; x++)
+            setShadow(x, y, color);
+#endif
+}
+
+void Renderer::cell(int x, int y, int color)
+{
+    run(x, y, x, y, color);
+
+    for (int i = 0; i < RENDER_MAX_SNAKES; i++)
+        if (x == headX[i] && y == headY[i])
+            headX[i] = headY[i] = -1;
+}
+
+// Draw a cached tile over one cell, or a plain cell without a cache
+void Renderer::tile(int tile, int x, int y, int color)
+{
+    if (tiles) {
+        batch.touch(CELL_PX(x), CELL_PX(y), CELL_PX(x) + CELL_SIZE, CELL_PX(y) + CELL_SIZE);
+        tiles->draw(tile, CELL_PX(x), CELL_PX(y));
+        commands++;
+        setDrawn(x, y, color);
+#if RENDER_VERIFY
+        setShadow(x, y, color);
+#endif
+    } else {
+        run(x, y, x, y, color);
+    }
+}
+
+void Renderer::head(int snake, int x, int y, int dir)
+{
+    int &hx = headX[snake];
+    int &hy = headY[snake];
+
+    if (tiles && hx >= 0 && !(hx == x && hy == y))
+        tile(TILE_BODY, hx, hy, GREEN);
+
+    tile(TILE_HEAD + dir, x, y, GREEN);
+    hx = x;
+    hy = y;
+}
+
+void Renderer::apple(int x, int y)
+{
+    tile(TILE_APPLE, x, y, RED);
+    appleX = x;
+    appleY = y;
+}
+
+void Renderer::resync(const SnakeBody &body, int foodx, int foody, bool clear)
+{
+    const SnakeBody *bodies[1] = { &body };
+    resync(bodies, 1, foodx, foody, clear);
+}
+
+void Renderer::resync(const SnakeBody *const *bodies, int count, int foodx, int foody, bool clear)
+{
+    resyncs++;
+
+    if (clear)
+        run(FIELD_MIN_X, FIELD_MIN_Y, FIELD_MAX_X, FIELD_MAX_Y, BLACK);
+
+    //set up field
+    lcd->line(7,23,623, 23, WHITE);
+    lcd->line(7,23,7, 463, WHITE);
+    lcd->line(623,23, 623, 463, WHITE);
+    lcd->line(7, 463, 623, 463, WHITE);
+    commands += 4;
+
+    if (foodx >= 0)
+        apple(foodx, foody);
+
+    drawBodies(bodies, count);
+
+    for (int i = 0; i < count && i < RENDER_MAX_SNAKES; i++) {
+        headX[i] = headY[i] = -1;
+        head(i, bodies[i]->headX(), bodies[i]->headY(), facing(*bodies[i]));
+    }
+}
+
+void Renderer::repair(const SnakeBody *const *bodies, int count, int foodx, int foody)
+{
+    markBodies(bodies, count);
+
+    //cells that became snake or stopped being one
+    for (int y = 0; y < FIELD_H; y++) {
+        for (int w = 0; w < (FIELD_W + 31) / 32; w++) {
+            unsigned int diff = occ[y][w] ^ drawn[y][w];
+            for (int x = w * 32; diff; x++, diff >>= 1) {
+                if (!(diff & 1))
+                    continue;
+                if (occupied(x, y))
+                    tile(TILE_BODY, x, y, GREEN);
+                else
+                    cell(x, y, BLACK);
+            }
+        }
+    }
+
+    if (foodx != appleX || foody != appleY) {
+        if (appleX >= 0 && !occupied(appleX, appleY))
+            cell(appleX, appleY, BLACK);
+        appleX = appleY = -1;
+        if (foodx >= 0)
+            apple(foodx, foody);
+    }
+
+    for (int i = 0; i < count && i < RENDER_MAX_SNAKES; i++) {
+        int x = bodies[i]->headX(), y = bodies[i]->headY();
+        if (x != headX[i] || y != headY[i])
+            head(i, x, y, facing(*bodies[i]));
+    }
+}
+
+// Direction of a head, away from its next segment
+int Renderer::facing(const SnakeBody &body)
+{
+    SnakeBody::iterator it = body.begin();
+    int x = it.x, y = it.y;
+    int dir = DIR_RIGHT;
+    it.next();
+    if (!it.done()) {
+        for (int d = 0; d < 4; d++)
+            if (it.x + dir_dx[d] == x && it.y + dir_dy[d] == y)
+                dir = d;
+    }
+    return dir;
+}
+
+void Renderer::markBodies(const SnakeBody *const *bodies, int count)
+{
+    memset(occ, 0, sizeof(occ));
+    for (int i = 0; i < count; i++) {
+        for (SnakeBody::iterator it = bodies[i]->begin(); !it.done(); it.next()) {
+            if (it.x < 0 || it.x >= FIELD_W || it.y < 0 || it.y >= FIELD_H)
+                continue;
+            occ[it.y][it.x >> 5] |= 1u << (it.x & 31);
+        }
+    }
+}
+
+// Cover the snakes with as few rectangles as possible.
+// Each row is split in spans of consecutive segments and every span is
+// extended down for as long as the rows below are filled across it, so
+// straight runs in either direction and coiled parts become one command.
+void Renderer::drawBodies(const SnakeBody *const *bodies, int count)
+{
+    markBodies(bodies, count);
+
+    bodyRects = 0;
+    for (int y = 0; y < FIELD_H; y++) {
+        int x = 0;
+        while (x < FIELD_W) {
+            if (!occupied(x, y)) {
+                x++;
+                continue;
+            }
+
+            //widest span on this row
+            int x1 = x;
+            while (x < FIELD_W && occupied(x, y))
+                clearOccupied(x++, y);
+            int x2 = x - 1;
+
+            //grow it down over full rows
+            int y2 = y;
+            for (;;) {
+                int below = y2 + 1;
+                if (below >= FIELD_H)
+                    break;
+                int i = x1;
+                while (i <= x2 && occupied(i, below))
+                    i++;
+                if (i <= x2)
+                    break;
+                for (i = x1; i <= x2; i++)
+                    clearOccupied(i, below);
+                y2 = below;
+            }
+
+            run(x1, y, x2, y2, GREEN);
+            bodyRects++;
+        }
+    }
+}
+
+int Renderer::verify(const SnakeBody &body, int foodx, int foody)
+{
+    const SnakeBody *bodies[1] = { &body };
+    return verify(bodies, 1, foodx, foody);
+}
+
+#if RENDER_VERIFY
+int Renderer::verify(const SnakeBody *const *bodies, int count, int foodx, int foody)
+{
+    int bad = 0;
+    int length = 0;
+
+    //every segment and the apple must be on screen
+    for (int i = 0; i < count; i++) {
+        for (SnakeBody::iterator it = bodies[i]->begin(); !it.done(); it.next())
+            if (shadowColor(it.x, it.y) != SH_GREEN)
+                bad++;
+        length += bodies[i]->length();
+    }
+    if (foodx >= 0 && shadowColor(foodx, foody) != SH_RED)
+        bad++;
+
+    //and nothing else may be left over
+    int green = 0, other = 0;
+    for (int y = FIELD_MIN_Y; y <= FIELD_MAX_Y; y++) {
+        for (int x = FIELD_MIN_X; x <= FIELD_MAX_X; x++) {
+            int c = shadowColor(x, y);
+            if (c == SH_GREEN)
+                green++;
+            else if (c != SH_BLACK && !(x == foodx && y == foody))
+                other++;
+        }
+    }
+    if (green > length)
+        bad += green - length;
+    bad += other;
+
+    drift += bad;
+    return bad;
+}
+#else
+int Renderer::verify(const SnakeBody *const *, int, int, int)
+{
+    return 0;
+}
+#endif
+
+#if RENDER_VERIFY
+int Renderer::shadowColor(int x, int y) const
+{
+    if (x < 0 || x >= FIELD_W || y < 0 || y >= FIELD_H)
+        return SH_OTHER;
+    return shadow[y][x];
+}
+
+void Renderer::setShadow(int x, int y, int color)
+{
+    if (x < 0 || x >= FIELD_W || y < 0 || y >= FIELD_H)
+        return;
+
+    switch (color) {
+        case BLACK :
+            shadow[y][x] = SH_BLACK;
+            break;
+        case GREEN :
+            shadow[y][x] = SH_GREEN;
+            break;
+        case RED :
+            shadow[y][x] = SH_RED;
+            break;
+        default :
+            shadow[y][x] = SH_OTHER;
+            break;
+    }
+}
+#endif
@@ -0,0 +1,109 @@
+#ifndef RENDERER_H
+#define RENDERER_H
+
+#include "TFT_4DGL.h"
+#include "field.h"
+#include "snakebody.h"
+#include "tilecache.h"
+#include "rectbatch.h"
+
+// Snakes whose heads are tracked
+#define RENDER_MAX_SNAKES 4
+
+// Keep a shadow of every cell drawn and check it against the game state
+#ifndef RENDER_VERIFY
+#define RENDER_VERIFY 0
+#endif
+
+// Draws the playfield on a TFT_4DGL.
+//
+// Two modes are used:
+//  - incremental : per tick only the new heads are drawn and the old tails erased
+//  - resync      : the whole field is redrawn, with the snakes decomposed into
+//                  maximal rectangles so each is one rectangle command
+//
+// Everything drawn in a tick is held until flush(), so all snakes' updates
+// leave as one batch per frame.
+class Renderer
+{
+public:
+    // tiles may be 0, everything is then drawn from primitives
+    Renderer(TFT_4DGL *lcd, TileCache *tiles);
+
+    // Incremental update of a single cell
+    void cell(int x, int y, int color);
+
+    // Draw a snake's head facing dir; its previous head becomes a body part
+    void head(int snake, int x, int y, int dir);
+
+    // Draw an apple
+    void apple(int x, int y);
+
+    // Full redraw of border, apple and snakes.
+    // When clear is set the field inside the border is blanked first.
+    void resync(const SnakeBody *const *bodies, int count, int foodx, int foody, bool clear);
+    void resync(const SnakeBody &body, int foodx, int foody, bool clear);
+
+    // Draw only the cells where the snakes and apple given differ from the
+    // screen, e.g. after the game was set back and run again
+    void repair(const SnakeBody *const *bodies, int count, int foodx, int foody);
+
+    // Send this frame's drawing to the display
+    void flush();
+
+    // Forget what is on screen, call after a cls()
+    void invalidate();
+
+    // Compares the simulated framebuffer with the game state and returns the
+    // number of cells that drifted. Always 0 when RENDER_VERIFY is off.
+    int verify(const SnakeBody *const *bodies, int count, int foodx, int foody);
+    int verify(const SnakeBody &body, int foodx, int foody);
+
+    // Statistics
+    int commands;   // draw commands issued, before coalescing
+    int resyncs;    // full redraws
+    int drift;      // drifted cells found by verify()
+    int bodyRects;  // rectangles used by the last full redraw of the snakes
+
+    // Coalescer counters
+    const RectBatch &rects() const { return batch; }
+
+private:
+    void rect(int x1, int y1, int x2, int y2, int color);
+    void run(int x1, int y1, int x2, int y2, int color);
+    void markBodies(const SnakeBody *const *bodies, int count);
+    void drawBodies(const SnakeBody *const *bodies, int count);
+    void setDrawn(int x, int y, int color);
+    static int facing(const SnakeBody &body);
+    void tile(int tile, int x, int y, int color);
+
+    bool occupied(int x, int y) const { return (occ[y][x >> 5] >> (x & 31)) & 1; }
+    void clearOccupied(int x, int y)  { occ[y][x >> 5] &= ~(1u << (x & 31)); }
+
+    TFT_4DGL *lcd;
+    TileCache *tiles;
+
+    // per-frame rectangle coalescer
+    RectBatch batch;
+
+    // cell holding each snake's head tile, -1 when none
+    int headX[RENDER_MAX_SNAKES];
+    int headY[RENDER_MAX_SNAKES];
+
+    // scratch occupancy bitmap for drawBodies() and repair()
+    unsigned int occ[FIELD_H][(FIELD_W + 31) / 32];
+
+    // cells drawn as snake, and the apple drawn last, as on screen
+    unsigned int drawn[FIELD_H][(FIELD_W + 31) / 32];
+    int appleX;
+    int appleY;
+
+#if RENDER_VERIFY
+    // simulated framebuffer, one colour per cell
+    int  shadowColor(int x, int y) const;
+    void setShadow(int x, int y, int color);
+    unsigned char shadow[FIELD_H][FIELD_W];
+#endif
+};
+
+#endif
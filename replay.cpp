@@ -0,0 +1,152 @@
+#include "string.h"
+#include "replay.h"
+
+// Room always kept for the end code, tick count and checksum
+#define TRAILER         9
+
+Replay::Replay()
+{
+    length = 0;
+    full = false;
+    players = 0;
+    seed = 0;
+    turns = 0;
+    ticks = 0;
+    play = 0;
+    playSize = 0;
+    pos = 0;
+    runLeft = 0;
+    done = false;
+    endTicks = 0;
+    endChecksum = 0;
+}
+
+bool Replay::put(int byte)
+{
+    if (full || length >= REPLAY_BUFFER - TRAILER) {
+        full = true;
+        return false;
+    }
+    buffer[length++] = byte;
+    return true;
+}
+
+unsigned int Replay::word(int at) const
+{
+    return play[at] | (play[at + 1] << 8) | (play[at + 2] << 16) | ((unsigned int)play[at + 3] << 24);
+}
+
+void Replay::start(const Game &game)
+{
+    length = 0;
+    full = false;
+    turns = 0;
+    ticks = 0;
+    players = game.players;
+    seed = game.seed;
+
+    const char magic[4] = { 'S', 'N', 'K', 'R' };
+    for (int i = 0; i < 4; i++)
+        put(magic[i]);
+    put(REPLAY_VERSION);
+    put(players);
+    for (int b = 0; b < 32; b += 8)
+        put((seed >> b) & 0xFF);
+}
+
+void Replay::turn(int player, int heading)
+{
+    if (put((player << 2) | heading))
+        turns++;
+}
+
+void Replay::tick()
+{
+    //a tick lengthens the run just recorded, up to 128
+    if (!full && length > REPLAY_HEADER && buffer[length - 1] >= REPLAY_RUN && buffer[length - 1] != 0xFF)
+        buffer[length - 1]++;
+    else if (!put(REPLAY_RUN))
+        return;
+    ticks++;
+}
+
+void Replay::finish(const Game &game)
+{
+    //a cut replay has no end: the state there is not known
+    if (full)
+        return;
+
+    unsigned int check = game.checksum();
+    buffer[length++] = REPLAY_END;
+    for (int b = 0; b < 32; b += 8)
+        buffer[length++] = (game.ticks >> b) & 0xFF;
+    for (int b = 0; b < 32; b += 8)
+        buffer[length++] = (check >> b) & 0xFF;
+}
+
+bool Replay::load(const unsigned char *data, int size)
+{
+    play = data;
+    playSize = size;
+    pos = REPLAY_HEADER;
+    runLeft = 0;
+    done = false;
+    turns = 0;
+    ticks = 0;
+
+    if (size < REPLAY_HEADER || memcmp(data, "SNKR", 4) != 0 || data[4] != REPLAY_VERSION)
+        return false;
+    players = data[5];
+    seed = word(6);
+    return true;
+}
+
+bool Replay::begin(Game &game)
+{
+    if (!play)
+        return false;
+    game.reset(players, seed);
+    pos = REPLAY_HEADER;
+    runLeft = 0;
+    done = false;
+    turns = 0;
+    ticks = 0;
+    return true;
+}
+
+bool Replay::step(Game &game)
+{
+    if (done)
+        return false;
+
+    //the turns before the next tick, up to its run
+    while (runLeft == 0) {
+        if (pos >= playSize)
+            return false;
+        int code = play[pos++];
+        if (code >= REPLAY_RUN) {
+            runLeft = (code & 0x7F) + 1;
+        } else if (code < 0x10) {
+            game.turn(code >> 2, code & 3);
+            turns++;
+        } else if (code == REPLAY_END && pos + 8 <= playSize) {
+            endTicks = word(pos);
+            endChecksum = word(pos + 4);
+            pos += 8;
+            done = true;
+            return false;
+        } else {
+            return false;
+        }
+    }
+
+    runLeft--;
+    game.tick();
+    ticks++;
+    return true;
+}
+
+bool Replay::matches(const Game &game) const
+{
+    return done && (unsigned int)game.ticks == endTicks && game.checksum() == endChecksum;
+}
@@ -0,0 +1,77 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "game.h"
+
+// Bytes a replay can take, header and trailer included
+#define REPLAY_BUFFER   4096
+
+// Replay file layout, all numbers little endian:
+//   'S' 'N' 'K' 'R', version, players, seed (4 bytes)
+//   then one byte per code:
+//     0x00-0x0F  turn taken before the next tick, player << 2 | heading
+//     0x80-0xFF  1 to 128 ticks in a row without turns
+//     0x40       end, followed by the tick count and Game::checksum() (4 bytes each)
+#define REPLAY_VERSION  1
+#define REPLAY_HEADER   10
+#define REPLAY_END      0x40
+#define REPLAY_RUN      0x80
+
+// Records a game as its seed and the turns it took, and plays it back.
+//
+// Apples come from the game's own generator, so the seed and the turns
+// accepted between ticks give the same game again. While recording a tick
+// costs one byte increment at most, and a turn one byte. Once the buffer is
+// full the rest of the game is not recorded; the replay still plays up to
+// there, and its checksum is not checked.
+class Replay
+{
+public:
+    Replay();
+
+    // Recording: a new game, the turns it accepts, its ticks, its end
+    void start(const Game &game);
+    void turn(int player, int heading);
+    void tick();
+    void finish(const Game &game);
+
+    const unsigned char *data() const { return buffer; }
+    int size() const { return length; }
+    bool truncated() const { return full; }
+
+    // Playback: take a replay, reset the game from its header, then step()
+    // applies its turns and runs one tick, false once it is over. Returns
+    // false when the data is not a replay.
+    bool load(const unsigned char *data, int size);
+    bool begin(Game &game);
+    bool step(Game &game);
+
+    // After the last step: the recorded game ended there, with the same state
+    bool ended() const { return done; }
+    bool matches(const Game &game) const;
+
+    int players;
+    unsigned int seed;
+
+    // Statistics
+    int turns;
+    int ticks;
+
+private:
+    bool put(int byte);
+    unsigned int word(int at) const;
+
+    unsigned char buffer[REPLAY_BUFFER];
+    int length;
+    bool full;
+
+    const unsigned char *play;
+    int playSize;
+    int pos;
+    int runLeft;        // ticks left in the run being played
+    bool done;
+    unsigned int endTicks;
+    unsigned int endChecksum;
+};
+
+#endif
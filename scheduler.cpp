@@ -0,0 +1,107 @@
+#include "scheduler.h"
+
+Scheduler::Scheduler(uint32_t (*clock)(void))
+{
+    this->clock = clock;
+    probe = 0;
+    ntasks = 0;
+    resetStats();
+}
+
+int Scheduler::add(const char *name, Run run, void *ctx, uint32_t period_us, Depth depth)
+{
+    if (ntasks == SCHED_MAX_TASKS)
+        return -1;
+
+    Task &t = tasks[ntasks];
+    t.name = name;
+    t.run = run;
+    t.ctx = ctx;
+    t.depth = depth;
+    t.period = period_us;
+    t.next = clock() + period_us;
+    t.signalled = false;
+
+    t.runs = 0;
+    t.late = 0;
+    t.total_us = 0;
+    t.max_us = 0;
+    t.max_depth = 0;
+    t.sum_depth = 0;
+    t.max_stack = 0;
+
+    return ntasks++;
+}
+
+void Scheduler::signal(int id)
+{
+    if (id >= 0 && id < ntasks)
+        tasks[id].signalled = true;
+}
+
+void Scheduler::resetStats()
+{
+    steps = 0;
+    idle = 0;
+    for (int i = 0; i < ntasks; i++) {
+        Task &t = tasks[i];
+        t.runs = 0;
+        t.late = 0;
+        t.total_us = 0;
+        t.max_us = 0;
+        t.max_depth = 0;
+        t.sum_depth = 0;
+        t.max_stack = 0;
+    }
+}
+
+int Scheduler::step()
+{
+    int ran = 0;
+
+    steps++;
+    for (int i = 0; i < ntasks; i++) {
+        Task &t = tasks[i];
+        uint32_t now = clock();
+
+        //signed difference so the comparison survives clock wrap
+        bool due = t.period && (int32_t)(now - t.next) >= 0;
+        if (!due && !t.signalled)
+            continue;
+
+        if (due) {
+            t.next += t.period;
+            if ((int32_t)(now - t.next) >= 0) {
+                //missed a whole period, don't try to catch up
+                t.late++;
+                t.next = now + t.period;
+            }
+        }
+        t.signalled = false;
+
+        if (t.depth) {
+            int d = t.depth(t.ctx);
+            t.sum_depth += d;
+            if (d > t.max_depth)
+                t.max_depth = d;
+        }
+
+        t.run(t.ctx);
+
+        uint32_t took = clock() - now;
+        t.total_us += took;
+        if (took > t.max_us)
+            t.max_us = took;
+        if (probe) {
+            int stack = probe();
+            if (stack > t.max_stack)
+                t.max_stack = stack;
+        }
+        t.runs++;
+        ran++;
+    }
+
+    if (!ran)
+        idle++;
+    return ran;
+}
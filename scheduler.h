@@ -0,0 +1,80 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+// Tasks a scheduler can hold
+#define SCHED_MAX_TASKS     8
+
+// Cooperative run-to-completion scheduler.
+//
+// Each task is a plain function that does a bounded amount of work and
+// returns. A task runs when its period has elapsed or when it has been
+// signalled, in the order the tasks were added, so earlier tasks have
+// priority. Nothing is preempted: while one task waits on nothing, the
+// others get the CPU, so I2C reads, game ticks and display traffic overlap
+// instead of running back to back.
+//
+// The clock is passed in (us_ticker_read on mbed), so the scheduler also
+// runs on a host.
+class Scheduler
+{
+public:
+    typedef void (*Run)(void *ctx);
+    typedef int (*Depth)(void *ctx);
+    typedef int (*Probe)(void);
+
+    Scheduler(uint32_t (*clock)(void));
+
+    // Add a task, returns its id or -1 when the table is full.
+    // period_us 0 means the task only runs when signalled.
+    // depth, when given, reports the task's queue depth before each run.
+    int add(const char *name, Run run, void *ctx, uint32_t period_us, Depth depth = 0);
+
+    // Make a task run at the next step() regardless of its period
+    void signal(int id);
+
+    // Run every task that is due, once. Returns the number of tasks run.
+    int step();
+
+    // Have probe() called after each task run, the stack it returns kept
+    // as the task's deepest
+    void stackProbe(Probe probe) { this->probe = probe; }
+
+    // Clear all statistics
+    void resetStats();
+
+    struct Task {
+        const char *name;
+        Run run;
+        Depth depth;
+        void *ctx;
+        uint32_t period;
+        uint32_t next;      // clock value of the next periodic run
+        bool signalled;
+
+        // Statistics
+        int runs;
+        int late;           // periodic runs started a whole period late
+        uint32_t total_us;  // time spent running
+        uint32_t max_us;    // longest run
+        int max_depth;      // deepest queue seen
+        int sum_depth;      // for the average, sum_depth / runs
+        int max_stack;      // deepest stack seen in bytes, 0 without a probe
+    };
+
+    int count() const { return ntasks; }
+    const Task &task(int id) const { return tasks[id]; }
+
+    // Statistics
+    int steps;              // step() calls
+    int idle;               // step() calls with nothing to run
+
+private:
+    uint32_t (*clock)(void);
+    Probe probe;
+    Task tasks[SCHED_MAX_TASKS];
+    int ntasks;
+};
+
+#endif
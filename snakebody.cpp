@@ -0,0 +1,130 @@
+#include "snakebody.h"
+
+//coordinate ring constructor
+CoordRing::CoordRing()
+{
+    reset(0, 0);
+}
+
+void CoordRing::reset(int x, int y)
+{
+    head = 0;
+    count = 1;
+    xs[0] = x;
+    ys[0] = y;
+}
+
+void CoordRing::advance(int dir, bool grow)
+{
+    int x = xs[head] + dir_dx[dir];
+    int y = ys[head] + dir_dy[dir];
+
+    if (++head == SNAKE_MAX_LEN)
+        head = 0;
+    xs[head] = x;
+    ys[head] = y;
+
+    if (grow && count < SNAKE_MAX_LEN)
+        count++;
+}
+
+CoordRing::iterator CoordRing::begin() const
+{
+    iterator it;
+    it.body = this;
+    it.index = head;
+    it.left = count;
+    it.x = xs[head];
+    it.y = ys[head];
+    return it;
+}
+
+void CoordRing::iterator::next()
+{
+    if (--left == 0)
+        return;
+    if (--index < 0)
+        index = SNAKE_MAX_LEN - 1;
+    x = body->xs[index];
+    y = body->ys[index];
+}
+
+
+//packed body constructor
+PackedBody::PackedBody()
+{
+    reset(0, 0);
+}
+
+void PackedBody::reset(int x, int y)
+{
+    first = 0;
+    links = 0;
+    hx = tx = x;
+    hy = ty = y;
+}
+
+void PackedBody::setLink(int i, int dir)
+{
+    int shift = (i & 3) << 1;
+    dirs[i >> 2] = (dirs[i >> 2] & ~(3 << shift)) | (dir << shift);
+}
+
+void PackedBody::advance(int dir, bool grow)
+{
+    hx += dir_dx[dir];
+    hy += dir_dy[dir];
+
+    if (grow && links < SNAKE_MAX_LEN - 1) {
+        int slot = first + links;
+        if (slot >= SNAKE_MAX_LEN)
+            slot -= SNAKE_MAX_LEN;
+        setLink(slot, dir);
+        links++;
+        return;
+    }
+
+    if (links == 0) {           // a single segment is both head and tail
+        tx = hx;
+        ty = hy;
+        return;
+    }
+
+    //the tail follows its own link, and that slot is reused for the new head
+    int t = getLink(first);
+    tx += dir_dx[t];
+    ty += dir_dy[t];
+
+    int slot = first + links;
+    if (slot >= SNAKE_MAX_LEN)
+        slot -= SNAKE_MAX_LEN;
+    setLink(slot, dir);
+    if (++first == SNAKE_MAX_LEN)
+        first = 0;
+}
+
+PackedBody::iterator PackedBody::begin() const
+{
+    iterator it;
+    it.body = this;
+    it.index = first + links - 1;
+    if (it.index >= SNAKE_MAX_LEN)
+        it.index -= SNAKE_MAX_LEN;
+    it.left = links + 1;
+    it.x = hx;
+    it.y = hy;
+    return it;
+}
+
+void PackedBody::iterator::next()
+{
+    if (--left == 0)
+        return;
+
+    //step back against the heading that led into the current segment
+    int d = body->getLink(index);
+    x -= dir_dx[d];
+    y -= dir_dy[d];
+    if (--index < 0)
+        index = SNAKE_MAX_LEN - 1;
+}
@@ -0,0 +1,144 @@
+#ifndef SNAKEBODY_H
+#define SNAKEBODY_H
+
+// Snake body storage, in playfield cells rather than pixels.
+//
+// Two interchangeable representations are provided:
+//  - CoordRing  : ring buffer of full (x,y) cell coordinates, 2 bytes per segment
+//  - PackedBody : head and tail coordinates plus one 2-bit heading per segment,
+//                 packed four per byte
+//
+// Both advance and grow in O(1). At maximum length (every playfield cell)
+// the coordinate ring needs ~7.8 KB of RAM while the packed body needs ~1 KB.
+// Walking the packed body costs a shift and a mask more per segment, which
+// only matters for full redraws.
+
+// Maximum number of segments, one per playfield cell (75 x 53)
+#define SNAKE_MAX_LEN   3975
+
+// Select the representation used by the game (see SnakeBody below)
+#ifndef SNAKE_PACKED_BODY
+#define SNAKE_PACKED_BODY 1
+#endif
+
+// Headings, 2 bits each. The opposite heading is (dir ^ 2)
+#define DIR_UP      0
+#define DIR_RIGHT   1
+#define DIR_DOWN    2
+#define DIR_LEFT    3
+
+// Cell offsets for each heading
+static const signed char dir_dx[4] = { 0, 1, 0, -1 };
+static const signed char dir_dy[4] = { -1, 0, 1, 0 };
+
+//coordinate ring buffer body
+class CoordRing
+{
+public:
+    CoordRing();
+
+    // Start a one segment snake at cell (x,y)
+    void reset(int x, int y);
+
+    // Move the head one cell towards dir, dropping the tail unless grow is set
+    void advance(int dir, bool grow);
+
+    int length() const { return count; }
+    int headX() const  { return xs[head]; }
+    int headY() const  { return ys[head]; }
+    int tailX() const  { return xs[tail()]; }
+    int tailY() const  { return ys[tail()]; }
+
+    // Memory taken by one body, in bytes
+    static int memoryBytes() { return sizeof(CoordRing); }
+
+    // Walks the body from head to tail
+    class iterator
+    {
+    public:
+        int x;
+        int y;
+
+        bool done() const { return left == 0; }
+        void next();
+
+    private:
+        friend class CoordRing;
+        const CoordRing *body;
+        int index;
+        int left;
+    };
+
+    iterator begin() const;
+
+private:
+    int tail() const { return (head + SNAKE_MAX_LEN - count + 1) % SNAKE_MAX_LEN; }
+
+    unsigned char xs[SNAKE_MAX_LEN];
+    unsigned char ys[SNAKE_MAX_LEN];
+    int head;
+    int count;
+};
+
+//packed direction-delta body
+class PackedBody
+{
+public:
+    PackedBody();
+
+    // Start a one segment snake at cell (x,y)
+    void reset(int x, int y);
+
+    // Move the head one cell towards dir, dropping the tail unless grow is set
+    void advance(int dir, bool grow);
+
+    int length() const { return links + 1; }
+    int headX() const  { return hx; }
+    int headY() const  { return hy; }
+    int tailX() const  { return tx; }
+    int tailY() const  { return ty; }
+
+    // Memory taken by one body, in bytes
+    static int memoryBytes() { return sizeof(PackedBody); }
+
+    // Walks the body from head to tail, rebuilding each segment position
+    // from the stored headings
+    class iterator
+    {
+    public:
+        int x;
+        int y;
+
+        bool done() const { return left == 0; }
+        void next();
+
+    private:
+        friend class PackedBody;
+        const PackedBody *body;
+        int index;
+        int left;
+    };
+
+    iterator begin() const;
+
+private:
+    // Heading stored in ring slot i
+    int getLink(int i) const { return (dirs[i >> 2] >> ((i & 3) << 1)) & 3; }
+    void setLink(int i, int dir);
+
+    // dirs[first] is the heading from the tail to the next segment,
+    // the last stored link is the heading into the head
+    unsigned char dirs[(SNAKE_MAX_LEN + 3) / 4];
+    int first;
+    int links;
+    short hx, hy;
+    short tx, ty;
+};
+
+#if SNAKE_PACKED_BODY
+typedef PackedBody SnakeBody;
+#else
+typedef CoordRing SnakeBody;
+#endif
+
+#endif
@@ -0,0 +1,178 @@
+#include "tilecache.h"
+
+// Tile drawing operations, relative to the tile origin
+#define OP_RECT     0
+#define OP_PIXEL    1
+#define OP_GCHAR    2
+
+struct TileOp {
+    char kind;
+    char x1, y1;
+    char x2, y2;    // for OP_GCHAR x2 is the character
+    int  color;
+};
+
+struct TileDef {
+    const TileOp *ops;
+    char count;
+    char w, h;
+};
+
+static const TileOp head_up[]    = { {OP_RECT, 0,0, 8,8, GREEN}, {OP_PIXEL, 2,2, 0,0, BLACK}, {OP_PIXEL, 6,2, 0,0, BLACK} };
+static const TileOp head_right[] = { {OP_RECT, 0,0, 8,8, GREEN}, {OP_PIXEL, 6,2, 0,0, BLACK}, {OP_PIXEL, 6,6, 0,0, BLACK} };
+static const TileOp head_down[]  = { {OP_RECT, 0,0, 8,8, GREEN}, {OP_PIXEL, 2,6, 0,0, BLACK}, {OP_PIXEL, 6,6, 0,0, BLACK} };
+static const TileOp head_left[]  = { {OP_RECT, 0,0, 8,8, GREEN}, {OP_PIXEL, 2,2, 0,0, BLACK}, {OP_PIXEL, 2,6, 0,0, BLACK} };
+static const TileOp body_ops[]   = { {OP_RECT, 0,0, 8,8, GREEN} };
+static const TileOp apple_ops[]  = { {OP_RECT, 0,0, 8,8, RED},   {OP_PIXEL, 4,1, 0,0, GREEN} };
+
+#define D(c) { {OP_RECT, 0,0, 7,7, BLACK}, {OP_GCHAR, 0,0, c,0, WHITE} }
+static const TileOp digit_ops[10][2] = { D('0'), D('1'), D('2'), D('3'), D('4'),
+                                         D('5'), D('6'), D('7'), D('8'), D('9') };
+#undef D
+
+static const TileDef tiles[NUM_TILES] = {
+    { head_up,      3, 9, 9 },
+    { head_right,   3, 9, 9 },
+    { head_down,    3, 9, 9 },
+    { head_left,    3, 9, 9 },
+    { body_ops,     1, 9, 9 },
+    { apple_ops,    2, 9, 9 },
+    { digit_ops[0], 2, 8, 8 },
+    { digit_ops[1], 2, 8, 8 },
+    { digit_ops[2], 2, 8, 8 },
+    { digit_ops[3], 2, 8, 8 },
+    { digit_ops[4], 2, 8, 8 },
+    { digit_ops[5], 2, 8, 8 },
+    { digit_ops[6], 2, 8, 8 },
+    { digit_ops[7], 2, 8, 8 },
+    { digit_ops[8], 2, 8, 8 },
+    { digit_ops[9], 2, 8, 8 },
+};
+
+//tile cache constructor
+TileCache::TileCache(TFT_4DGL *lcd, int x, int y, int w, int h)
+{
+    this->lcd = lcd;
+
+    originX = x;
+    originY = y;
+    rows = h / TILE_SLOT;
+    slots = rows * (w / TILE_SLOT);
+    if (slots > TILE_MAX_SLOTS)
+        slots = TILE_MAX_SLOTS;
+
+    blits = 0;
+    prims = 0;
+    fills = 0;
+
+    invalidate();
+}
+
+void TileCache::invalidate()
+{
+    memset(used, 0, sizeof(used));
+    for (int i = 0; i < NUM_TILES; i++)
+        slotOf[i] = -1;
+}
+
+void TileCache::evict(int tile)
+{
+    if (tile < 0 || tile >= NUM_TILES || slotOf[tile] < 0)
+        return;
+    freeSlot(slotOf[tile]);
+    slotOf[tile] = -1;
+}
+
+int TileCache::allocSlot()
+{
+    for (int i = 0; i < slots; i++) {
+        if (!(used[i >> 5] & (1u << (i & 31)))) {
+            used[i >> 5] |= 1u << (i & 31);
+            return i;
+        }
+    }
+    return -1;
+}
+
+void TileCache::freeSlot(int slot)
+{
+    used[slot >> 5] &= ~(1u << (slot & 31));
+}
+
+int TileCache::primitiveCost(int tile) const
+{
+    int cost = 0;
+
+    for (int i = 0; i < tiles[tile].count; i++) {
+        switch (tiles[tile].ops[i].kind) {
+            case OP_RECT :
+                cost += COST_RECT + COST_ACK;
+                break;
+            case OP_PIXEL :
+                cost += COST_PIXEL + COST_ACK;
+                break;
+            case OP_GCHAR :
+                cost += COST_GCHAR + COST_ACK;
+                break;
+        }
+    }
+    return cost;
+}
+
+void TileCache::render(int tile, int x, int y)
+{
+    const TileDef &t = tiles[tile];
+
+    for (int i = 0; i < t.count; i++) {
+        const TileOp &op = t.ops[i];
+        switch (op.kind) {
+            case OP_RECT :
+                lcd->rectangle(x + op.x1, y + op.y1, x + op.x2, y + op.y2, op.color);
+                break;
+            case OP_PIXEL :
+                lcd->pixel(x + op.x1, y + op.y1, op.color);
+                break;
+            case OP_GCHAR :
+                lcd->graphic_char(op.x2, x + op.x1, y + op.y1, op.color, 1, 1);
+                break;
+        }
+    }
+}
+
+bool TileCache::fill(int tile)
+{
+    int slot = allocSlot();
+    if (slot < 0)
+        return false;
+
+    render(tile, slotX(slot), slotY(slot));
+    slotOf[tile] = slot;
+    fills++;
+    return true;
+}
+
+void TileCache::preload()
+{
+    for (int i = 0; i < NUM_TILES; i++)
+        if (slotOf[i] < 0 && cacheable(i))
+            fill(i);
+}
+
+void TileCache::draw(int tile, int x, int y)
+{
+    if (tile < 0 || tile >= NUM_TILES)
+        return;
+
+    //render into the store on first use when copies are cheaper
+    if (slotOf[tile] < 0 && cacheable(tile))
+        fill(tile);
+
+    int slot = slotOf[tile];
+    if (slot >= 0) {
+        lcd->screen_copy(slotX(slot), slotY(slot), x, y, tiles[tile].w, tiles[tile].h);
+        blits++;
+    } else {
+        render(tile, x, y);
+        prims++;
+    }
+}
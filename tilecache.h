@@ -0,0 +1,83 @@
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include "TFT_4DGL.h"
+
+// Tiles drawn from the cache
+#define TILE_HEAD       0   // + heading, see snakebody.h
+#define TILE_BODY       4
+#define TILE_APPLE      5
+#define TILE_DIGIT      6   // + digit value
+#define NUM_TILES       16
+
+// Slot size in the tile store, big enough for one 9x9 playfield cell
+#define TILE_SLOT       9
+#define TILE_MAX_SLOTS  64
+
+// Cost model, in bytes on the wire. Every command also pays for its ACK
+// round trip, which dominates for short commands.
+#define COST_ACK        8
+#define COST_RECT       11
+#define COST_PIXEL      7
+#define COST_GCHAR      10
+#define COST_BLIT       13
+
+// Tile cache using an unused area of the display as a tile store.
+//
+// Tiles are rendered once from primitives into a slot of the store and then
+// copied to their destination with one SCREENCOPY command. The store is
+// visible screen memory (the 4DGL serial protocol has no off-screen
+// buffer), so it must be placed outside anything else that is drawn, and
+// invalidate() must be called after a cls().
+class TileCache
+{
+public:
+    // The store covers w x h pixels from (x,y)
+    TileCache(TFT_4DGL *lcd, int x, int y, int w, int h);
+
+    // Draw a tile with its top left corner at pixel (x,y), either by copying
+    // it from the store or from primitives, whichever the cost model prefers
+    void draw(int tile, int x, int y);
+
+    // Render every tile worth caching into the store
+    void preload();
+
+    // Forget the store contents, e.g. after the screen was cleared
+    void invalidate();
+
+    // Release the store slot of one tile
+    void evict(int tile);
+
+    // Cost of drawing a tile from primitives, and whether it is worth caching
+    int primitiveCost(int tile) const;
+    bool cacheable(int tile) const { return primitiveCost(tile) > COST_BLIT + COST_ACK; }
+
+    // Statistics
+    int blits;      // tiles copied from the store
+    int prims;      // tiles drawn from primitives
+    int fills;      // tiles rendered into the store
+
+private:
+    bool fill(int tile);
+    void render(int tile, int x, int y);
+
+    int  allocSlot();
+    void freeSlot(int slot);
+    int  slotX(int slot) const { return originX + (slot / rows) * TILE_SLOT; }
+    int  slotY(int slot) const { return originY + (slot % rows) * TILE_SLOT; }
+
+    TFT_4DGL *lcd;
+
+    int originX;
+    int originY;
+    int rows;
+    int slots;
+
+    // allocation map of the store, one bit per slot
+    unsigned int used[(TILE_MAX_SLOTS + 31) / 32];
+
+    // store slot of each tile, -1 when not resident
+    signed char slotOf[NUM_TILES];
+};
+
+#endif
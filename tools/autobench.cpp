@@ -0,0 +1,124 @@
+// Search cost of the autopilot per tick, by snake length, on the host.
+//
+//   g++ -O2 -o autobench -I. tools/autobench.cpp autopilot.cpp game.cpp snakebody.cpp
+//   ./autobench [games] [players]
+//
+// The autopilot plays whole games. Every tick its repaired distances are
+// checked against a full search, and the cells it took off its queue are
+// counted for the update and for the move choice; a cell is a pop with
+// its four neighbours looked at, the unit that sets the time on the mbed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "autopilot.h"
+
+// Games stop after this many ticks
+#define BENCH_TICKS     20000
+// Snake length classes reported, upper bounds
+static const int classes[] = { 50, 100, 200, 400, 800, 1600, SNAKE_MAX_LEN + 1 };
+#define CLASSES         (int)(sizeof(classes) / sizeof(classes[0]))
+
+struct Class {
+    long ticks;
+    long updateCells;
+    int updateMax;
+    long chooseCells;
+    int chooseMax;
+    long rebuilds;
+    double ns;
+    double maxNs;
+};
+
+static Game game;
+static Autopilot pilot;
+static Autopilot check;
+
+static double now_ns()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+    int games = argc > 1 ? atoi(argv[1]) : 20;
+    int players = argc > 2 ? atoi(argv[2]) : 1;
+    Class stats[CLASSES];
+    memset(stats, 0, sizeof(stats));
+    long wrong = 0, ticks = 0, apples = 0, unsafe = 0, overflows = 0;
+    int longest = 0;
+
+    for (int g = 0; g < games; g++) {
+        game.reset(players, g + 1);
+        pilot.reset(game);
+
+        for (int t = 0; t < BENCH_TICKS && !game.over; t++) {
+            double t0 = now_ns();
+            int rebuilds = pilot.rebuilds;
+
+            int choose = 0;
+            for (int i = 0; i < game.players; i++) {
+                int before = pilot.lastCells;
+                int h = pilot.choose(game, i);
+                choose += pilot.lastCells - before;
+                if (h != game.snakes[i].heading)
+                    game.turn(i, h);
+            }
+            game.tick();
+            pilot.update(game);
+            double ns = now_ns() - t0;
+
+            int length = game.snakes[0].body.length();
+            int c = 0;
+            while (length >= classes[c])
+                c++;
+            Class &s = stats[c];
+            s.ticks++;
+            s.updateCells += pilot.lastCells;
+            if (pilot.lastCells > s.updateMax)
+                s.updateMax = pilot.lastCells;
+            s.chooseCells += choose;
+            if (choose > s.chooseMax)
+                s.chooseMax = choose;
+            s.rebuilds += pilot.rebuilds - rebuilds;
+            s.ns += ns;
+            if (ns > s.maxNs)
+                s.maxNs = ns;
+            if (length > longest)
+                longest = length;
+            ticks++;
+
+            //the repaired distances against a fresh search
+            check.reset(game);
+            for (int y = 0; y < FIELD_H; y++)
+                for (int x = 0; x < FIELD_W; x++)
+                    if (check.distance(x, y) != pilot.distance(x, y))
+                        wrong++;
+        }
+        for (int i = 0; i < game.players; i++)
+            apples += game.snakes[i].points;
+        unsafe += pilot.unsafe;
+        overflows += pilot.overflows;
+        pilot.unsafe = 0;
+        pilot.overflows = 0;
+    }
+
+    printf("%d games of %d, %ld ticks, %ld apples, longest snake %d, %ld unsafe moves, %ld overflows\n",
+           games, players, ticks, apples, longest, unsafe, overflows);
+    printf("cells differing from a full search: %ld\n\n", wrong);
+    printf("length     ticks  update avg  max  rebuilt  choose avg  max   host us avg  max\n");
+    int low = 0;
+    for (int c = 0; c < CLASSES; c++) {
+        const Class &s = stats[c];
+        if (s.ticks)
+            printf("%4d-%-4d %7ld  %10ld %4d  %6.1f%%  %10ld %4d  %12.1f %4.0f\n",
+                   low, classes[c] - 1 > SNAKE_MAX_LEN ? SNAKE_MAX_LEN : classes[c] - 1, s.ticks,
+                   s.updateCells / s.ticks, s.updateMax, 100.0 * s.rebuilds / s.ticks,
+                   s.chooseCells / s.ticks, s.chooseMax, s.ns / s.ticks / 1000, s.maxNs / 1000);
+        low = classes[c];
+    }
+    return 0;
+}
@@ -0,0 +1,166 @@
+// Bytes on the wire and round trips to draw a picture with pixels,
+// rectangles, a raw display image and blit(), on the host simulator.
+//
+//   g++ -o blitbench tools/blitbench.cpp 4DGL/TFT_4DGL_*.cpp -I4DGL -DTFT_4DGL_HOST=1
+//   ./blitbench [picture.ppm ...]
+//
+// Without pictures it measures a game over banner and a textured tile
+// made up here. Every method is checked against the picture afterwards.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "TFT_4DGL.h"
+#include "imgenc.h"
+
+// Link speed main() uses
+#define BENCH_BAUD  115200
+// Where pictures are drawn on the simulated screen
+#define BENCH_X     8
+#define BENCH_Y     8
+
+static TFT_4DGL_Base<SimTransport> vga(0, 0, 0, BENCH_BAUD);
+
+static int rgb888(unsigned short c)
+{
+    return ((c >> 11) << 19) | (((c >> 5) & 0x3F) << 10) | ((c & 0x1F) << 3);
+}
+
+// Game over banner: border and blocky stripes on black, long runs
+static Picture banner()
+{
+    Picture p;
+    p.width = 272;
+    p.height = 32;
+    p.pixels.resize(p.width * p.height);
+    for (int y = 0; y < p.height; y++) {
+        for (int x = 0; x < p.width; x++) {
+            unsigned short c = 0;
+            if (x < 2 || y < 2 || x >= p.width - 2 || y >= p.height - 2)
+                c = 0xFFFF;
+            else if (y >= 8 && y < 24 && (x / 8) % 3 != 2)
+                c = ((x / 24) & 1) ? 0xF800 : 0xFFE0;
+            p.pixels[y * p.width + x] = c;
+        }
+    }
+    return p;
+}
+
+// 32x32 texture in 16 greens, short runs
+static Picture texture()
+{
+    Picture p;
+    p.width = 32;
+    p.height = 32;
+    p.pixels.resize(p.width * p.height);
+    srand(1);
+    for (int i = 0; i < p.width * p.height; i++)
+        p.pixels[i] = (16 + rand() % 16) << 6;
+    return p;
+}
+
+// Pixels of the picture the screen got wrong
+static int mismatches(const Picture &p, bool color8)
+{
+    int wrong = 0;
+    for (int y = 0; y < p.height; y++) {
+        for (int x = 0; x < p.width; x++) {
+            unsigned short want = p.pixels[y * p.width + x];
+            if (color8)
+                want = color8_to_16(color16_to_8(want));
+            if (vga.transport().frame[BENCH_Y + y][BENCH_X + x] != want)
+                wrong++;
+        }
+    }
+    return wrong;
+}
+
+static int startBytes;
+static int startCommands;
+
+static void begin()
+{
+    vga.rectangle(0, 0, SIM_WIDTH - 1, SIM_HEIGHT - 1, 0x123456);   // anything the picture is not
+    startBytes = vga.transport().bytes;
+    startCommands = vga.transport().commands;
+}
+
+static void end(const char *method, const Picture &p, bool color8)
+{
+    int bytes = vga.transport().bytes - startBytes;
+    int commands = vga.transport().commands - startCommands;
+    //every round trip also brings an answer byte back
+    printf("  %-14s %8d bytes %6d round trips %8.1f ms on the wire %6d wrong\n", method, bytes, commands,
+           (bytes + commands) * 10000.0 / BENCH_BAUD, mismatches(p, color8));
+}
+
+static void bench(const char *name, const Picture &p)
+{
+    printf("%s, %dx%d\n", name, p.width, p.height);
+
+    begin();
+    for (int y = 0; y < p.height; y++)
+        for (int x = 0; x < p.width; x++)
+            vga.pixel(BENCH_X + x, BENCH_Y + y, rgb888(p.pixels[y * p.width + x]));
+    end("pixel", p, false);
+
+    //background first, then every other run of a row as a one line rectangle
+    begin();
+    vga.pen_size(SOLID);
+    unsigned short background = p.pixels[0];
+    vga.rectangle(BENCH_X, BENCH_Y, BENCH_X + p.width - 1, BENCH_Y + p.height - 1, rgb888(background));
+    for (int y = 0; y < p.height; y++) {
+        for (int x = 0; x < p.width; ) {
+            unsigned short c = p.pixels[y * p.width + x];
+            int run = 1;
+            while (x + run < p.width && p.pixels[y * p.width + x + run] == c)
+                run++;
+            if (c != background)
+                vga.rectangle(BENCH_X + x, BENCH_Y + y, BENCH_X + x + run - 1, BENCH_Y + y, rgb888(c));
+            x += run;
+        }
+    }
+    end("rectangles", p, false);
+
+    begin();
+    std::vector<char> raw;
+    for (size_t i = 0; i < p.pixels.size(); i++) {
+        raw.push_back(p.pixels[i] >> 8);
+        raw.push_back(p.pixels[i] & 0xFF);
+    }
+    vga.display_image(BENCH_X, BENCH_Y, p.width, p.height, COLOR_16BIT, &raw[0]);
+    end("image 16 bit", p, false);
+
+    Encoded e;
+    if (!encode(p, -1, &e))
+        return;
+    TFT_4DGL_Image image = { (short)p.width, (short)p.height, (char)e.format, (short)e.palette.size(),
+                             e.palette.empty() ? 0 : &e.palette[0], &e.data[0], (int)e.data.size() };
+    bool color8 = !e.palette.empty();
+    for (size_t i = 0; i < e.palette.size(); i++)
+        if (color8_to_16(color16_to_8(e.palette[i])) != e.palette[i])
+            color8 = false;
+    static const char *formats[] = { "blit rgb565", "blit palette", "blit rle" };
+    begin();
+    vga.blit(BENCH_X, BENCH_Y, &image);
+    end(formats[e.format], p, false);
+    printf("  %-14s %8d bytes in flash, %s on the wire\n", "", (int)(e.data.size() + 2 * e.palette.size()),
+           color8 ? "8 bit" : "16 bit");
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        bench("banner", banner());
+        bench("texture", texture());
+    }
+    for (int i = 1; i < argc; i++) {
+        Picture p;
+        if (!loadPpm(argv[i], &p)) {
+            fprintf(stderr, "blitbench: cannot read %s\n", argv[i]);
+            return 1;
+        }
+        bench(argv[i], p);
+    }
+    printf("display: %d timeouts, %d resyncs\n", vga.reply_timeouts, vga.resyncs);
+    return 0;
+}
@@ -0,0 +1,155 @@
+// Cost of a snake body per tick and per full walk, on the host.
+//
+//   g++ -O2 -o bodybench -I. tools/bodybench.cpp snakebody.cpp
+//   ./bodybench
+//
+// Compares the body the game started with, a std::list of one 16 byte
+// part per segment with a node allocated each tick, the ring of cell
+// coordinates and the packed headings. A tick is what Game::tick() asks of
+// a body: advance without growing and read the new tail. A walk visits
+// every segment from head to tail, as a full redraw does.
+//
+// The snake runs a serpentine path across the playfield, so lengths up to
+// SNAKE_MAX_LEN stay on it.
+
+#include <stdio.h>
+#include <time.h>
+#include <list>
+#include "snakebody.h"
+#include "field.h"
+
+// Ticks timed per length, and walks
+#define BENCH_TICKS     4000000
+#define BENCH_WALK_SEGS 40000000L
+// Runs per length, the fastest is reported
+#define BENCH_RUNS      3
+
+// The snake class of the original game, one per segment
+struct Part {
+    int x;
+    int y;
+    int size;
+    int color;
+};
+
+// Serpentine: 25 times right 70, down, left 70, down, then up 50 to the
+// start
+#define PATH_LEN    (25 * 142 + 50)
+static unsigned char path[PATH_LEN];
+
+static void makePath()
+{
+    int n = 0;
+    for (int r = 0; r < 25; r++) {
+        for (int i = 0; i < 70; i++) path[n++] = DIR_RIGHT;
+        path[n++] = DIR_DOWN;
+        for (int i = 0; i < 70; i++) path[n++] = DIR_LEFT;
+        path[n++] = DIR_DOWN;
+    }
+    for (int i = 0; i < 50; i++)
+        path[n++] = DIR_UP;
+}
+
+static double now_ns()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static volatile int sink;
+
+template <class Body>
+static void bench(Body &body, int length, double *tickNs, double *segNs)
+{
+    body.reset(FIELD_MIN_X, FIELD_MIN_Y);
+    int step = 0;
+    for (int n = 1; n < length; n++) {
+        body.advance(path[step], true);
+        step = (step + 1) % PATH_LEN;
+    }
+
+    int sum = 0;
+    double t = now_ns();
+    for (int i = 0; i < BENCH_TICKS; i++) {
+        body.advance(path[step], false);
+        sum += body.tailX();
+        if (++step == PATH_LEN)
+            step = 0;
+    }
+    *tickNs = (now_ns() - t) / BENCH_TICKS;
+
+    long walks = BENCH_WALK_SEGS / length;
+    t = now_ns();
+    for (long w = 0; w < walks; w++)
+        for (typename Body::iterator it = body.begin(); !it.done(); it.next())
+            sum += it.x;
+    *segNs = (now_ns() - t) / (walks * length);
+    sink = sum;
+}
+
+static void benchList(int length, double *tickNs, double *segNs)
+{
+    std::list<Part> parts;
+    Part p = { FIELD_MIN_X, FIELD_MIN_Y, 8, 0 };
+    parts.push_front(p);
+    int step = 0;
+    for (int n = 1; n < length; n++) {
+        p.x += dir_dx[path[step]];
+        p.y += dir_dy[path[step]];
+        parts.push_front(p);
+        step = (step + 1) % PATH_LEN;
+    }
+
+    int sum = 0;
+    double t = now_ns();
+    for (int i = 0; i < BENCH_TICKS; i++) {
+        p.x += dir_dx[path[step]];
+        p.y += dir_dy[path[step]];
+        parts.push_front(p);
+        parts.pop_back();
+        sum += parts.back().x;
+        if (++step == PATH_LEN)
+            step = 0;
+    }
+    *tickNs = (now_ns() - t) / BENCH_TICKS;
+
+    long walks = BENCH_WALK_SEGS / length;
+    t = now_ns();
+    for (long w = 0; w < walks; w++)
+        for (std::list<Part>::const_iterator it = parts.begin(); it != parts.end(); ++it)
+            sum += it->x;
+    *segNs = (now_ns() - t) / (walks * length);
+    sink = sum;
+}
+
+static CoordRing ring;
+static PackedBody packed;
+
+int main()
+{
+    static const int lengths[] = { 30, 300, 1000, SNAKE_MAX_LEN };
+    makePath();
+
+    printf("bytes at %d segments: list %d (16 byte parts, plus heap nodes), ring %d, packed %d\n\n",
+           SNAKE_MAX_LEN, (int)(SNAKE_MAX_LEN * sizeof(Part)), CoordRing::memoryBytes(),
+           PackedBody::memoryBytes());
+    printf("length      ns per tick: list  ring  packed     ns per segment walked: list  ring  packed\n");
+    for (unsigned int i = 0; i < sizeof(lengths) / sizeof(lengths[0]); i++) {
+        int n = lengths[i];
+        //best of a few runs, the host has other work
+        double best[6] = { 1e9, 1e9, 1e9, 1e9, 1e9, 1e9 };
+        for (int run = 0; run < BENCH_RUNS; run++) {
+            double r[6];
+            benchList(n, &r[0], &r[3]);
+            bench(ring, n, &r[1], &r[4]);
+            bench(packed, n, &r[2], &r[5]);
+            for (int k = 0; k < 6; k++)
+                if (r[k] < best[k])
+                    best[k] = r[k];
+        }
+        printf("%6d %21.1f %5.1f %7.1f %30.2f %5.2f %7.2f\n", n, best[0], best[1], best[2],
+               best[3], best[4], best[5]);
+    }
+    return 0;
+}
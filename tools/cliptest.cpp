@@ -0,0 +1,239 @@
+// Rectangles, screen copies and images cut by the clip rectangle or the
+// screen edges, on the host simulator.
+//
+//   g++ -o cliptest tools/cliptest.cpp 4DGL/TFT_4DGL_*.cpp -I4DGL -DTFT_4DGL_HOST=1
+//   ./cliptest
+//
+// Rectangles straddling each edge and corner of a clip rectangle are drawn
+// with the pen as the screen has it after a reset, never set by the driver,
+// then solid and wireframe. The simulated screen must show the part inside
+// the clip rectangle, filled or as the sides that were not cut, and
+// nothing outside it.
+//
+// Screen copies and images, raw and run length coded, are then placed
+// across the clip rectangle and off each side of the screen. Only their
+// visible part may change the screen, and the command that is sent must
+// carry as many pixels as it announces, or what follows is read as pixels.
+
+#include <stdio.h>
+#include <string.h>
+#include "TFT_4DGL.h"
+
+#define CLIP_X1     200
+#define CLIP_Y1     150
+#define CLIP_X2     399
+#define CLIP_Y2     299
+
+static TFT_4DGL_Base<SimTransport> vga(0, 0, 0, 115200);
+
+static int failures;
+
+static bool inside(int x, int y, int x1, int y1, int x2, int y2)
+{
+    return x >= x1 && x <= x2 && y >= y1 && y <= y2;
+}
+
+// Pixel expected for a rectangle at x1, y1, x2, y2 seen through the clip
+// rectangle
+static bool lit(int x, int y, int x1, int y1, int x2, int y2, bool filled)
+{
+    if (!inside(x, y, CLIP_X1, CLIP_Y1, CLIP_X2, CLIP_Y2) || !inside(x, y, x1, y1, x2, y2))
+        return false;
+    return filled || x == x1 || x == x2 || y == y1 || y == y2;
+}
+
+static void check(const char *pen, int x1, int y1, int x2, int y2, bool filled)
+{
+    vga.cls();
+    vga.push_clip(CLIP_X1, CLIP_Y1, CLIP_X2, CLIP_Y2);
+    vga.rectangle(x1, y1, x2, y2, WHITE);
+    vga.pop_clip();
+
+    int wrong = 0;
+    for (int y = 0; y < SIM_HEIGHT; y++)
+        for (int x = 0; x < SIM_WIDTH; x++)
+            if ((vga.transport().frame[y][x] != 0) != lit(x, y, x1, y1, x2, y2, filled))
+                wrong++;
+    if (wrong) {
+        printf("FAIL %s pen, rectangle %d,%d %d,%d: %d pixels wrong\n", pen, x1, y1, x2, y2, wrong);
+        failures++;
+    }
+}
+
+// Across each edge and each corner of the clip rectangle
+static void straddle(const char *pen, bool filled)
+{
+    static const int rects[][4] = {
+        { 150, 200, 250, 250 },     // left edge
+        { 350, 200, 450, 250 },     // right edge
+        { 250, 100, 300, 200 },     // top edge
+        { 250, 250, 300, 350 },     // bottom edge
+        { 150, 100, 250, 200 },     // top left corner
+        { 350, 250, 450, 350 },     // bottom right corner
+        { 100,  50, 500, 400 },     // all around
+    };
+    for (unsigned int i = 0; i < sizeof(rects) / sizeof(rects[0]); i++)
+        check(pen, rects[i][0], rects[i][1], rects[i][2], rects[i][3], filled);
+}
+
+// Image size, and the length of the runs of the coded one
+#define IMAGE_W     100
+#define IMAGE_H     80
+#define IMAGE_RUN   37
+
+static char raw[IMAGE_H][IMAGE_W][2];
+static const unsigned short palette[4] = { 0xF800, 0x07E0, 0x001F, 0xFFFF };
+static unsigned char runs[2 * (IMAGE_W * IMAGE_H / IMAGE_RUN + 1)];
+static const TFT_4DGL_Image coded = { IMAGE_W, IMAGE_H, IMAGE_RLE, 4, palette, runs, sizeof(runs) };
+
+static unsigned short before[SIM_HEIGHT][SIM_WIDTH];
+static unsigned short expected[SIM_HEIGHT][SIM_WIDTH];
+
+// Colour of each pixel of the images, never black
+static unsigned short rawColor(int x, int y)
+{
+    return (unsigned short)((x * 7 + y * 640) | 0x0821);
+}
+
+static unsigned short codedColor(int x, int y)
+{
+    return palette[(y * IMAGE_W + x) / IMAGE_RUN % 4];
+}
+
+static void makeImages()
+{
+    for (int y = 0; y < IMAGE_H; y++) {
+        for (int x = 0; x < IMAGE_W; x++) {
+            raw[y][x][0] = rawColor(x, y) >> 8;
+            raw[y][x][1] = rawColor(x, y) & 0xFF;
+        }
+    }
+    for (int i = 0; i < (int)sizeof(runs) / 2; i++) {  //runs cross the row ends
+        runs[2 * i] = IMAGE_RUN;
+        runs[2 * i + 1] = i % 4;
+    }
+}
+
+static bool visible(int x, int y, bool clip)
+{
+    if (x < 0 || y < 0 || x >= SIM_WIDTH || y >= SIM_HEIGHT)
+        return false;
+    return !clip || inside(x, y, CLIP_X1, CLIP_Y1, CLIP_X2, CLIP_Y2);
+}
+
+static void compare(const char *what, int x, int y)
+{
+    int wrong = 0;
+    for (int j = 0; j < SIM_HEIGHT; j++)
+        for (int i = 0; i < SIM_WIDTH; i++)
+            if (vga.transport().frame[j][i] != expected[j][i])
+                wrong++;
+
+    //a pixel count that did not match the command would have eaten this
+    vga.pixel(0, 0, WHITE);
+    if (vga.transport().frame[0][0] != 0xFFFF)
+        wrong++;
+
+    if (wrong) {
+        printf("FAIL %s at %d,%d: %d pixels wrong\n", what, x, y, wrong);
+        failures++;
+    }
+}
+
+// Image at x, y, raw or coded, seen through the clip rectangle if clip
+static void image(int x, int y, bool coded_, bool clip)
+{
+    vga.cls();
+    memset(expected, 0, sizeof(expected));
+    for (int j = 0; j < IMAGE_H; j++)
+        for (int i = 0; i < IMAGE_W; i++)
+            if (visible(x + i, y + j, clip))
+                expected[y + j][x + i] = coded_ ? codedColor(i, j) : rawColor(i, j);
+
+    if (clip)
+        vga.push_clip(CLIP_X1, CLIP_Y1, CLIP_X2, CLIP_Y2);
+    if (coded_)
+        vga.blit(x, y, &coded);
+    else
+        vga.display_image(x, y, IMAGE_W, IMAGE_H, COLOR_16BIT, &raw[0][0][0]);
+    if (clip)
+        vga.pop_clip();
+
+    compare(coded_ ? "coded image" : "raw image", x, y);
+}
+
+// Copy of the block at xs, ys to xd, yd, from a screen with an image in
+// each corner
+static void copy(int xs, int ys, int xd, int yd, bool clip)
+{
+    vga.cls();
+    vga.display_image(0, 0, IMAGE_W, IMAGE_H, COLOR_16BIT, &raw[0][0][0]);
+    vga.display_image(SIM_WIDTH - IMAGE_W, SIM_HEIGHT - IMAGE_H, IMAGE_W, IMAGE_H, COLOR_16BIT,
+                      &raw[0][0][0]);
+    memcpy(before, vga.transport().frame, sizeof(before));
+    memcpy(expected, before, sizeof(expected));
+    for (int j = 0; j < IMAGE_H; j++)
+        for (int i = 0; i < IMAGE_W; i++)
+            if (visible(xd + i, yd + j, clip) && visible(xs + i, ys + j, false))
+                expected[yd + j][xd + i] = before[ys + j][xs + i];
+
+    if (clip)
+        vga.push_clip(CLIP_X1, CLIP_Y1, CLIP_X2, CLIP_Y2);
+    vga.screen_copy(xs, ys, xd, yd, IMAGE_W, IMAGE_H);
+    if (clip)
+        vga.pop_clip();
+
+    compare("screen copy", xd, yd);
+}
+
+// Top left corners across the clip rectangle and off the screen
+static const int places[][2] = {
+    { 150, 200 },       // clip left edge
+    { 350, 200 },       // clip right edge
+    { 250, 100 },       // clip top edge
+    { 250, 250 },       // clip bottom edge
+    { 150, 100 },       // clip top left corner
+    { 350, 250 },       // clip bottom right corner
+    { -30, -20 },       // screen top left corner
+    { 580, 200 },       // screen right edge
+    { 300, 430 },       // screen bottom edge
+};
+#define PLACES      (int)(sizeof(places) / sizeof(places[0]))
+
+static void blocks()
+{
+    makeImages();
+    for (int i = 0; i < PLACES; i++) {
+        bool clip = i < 6;
+        image(places[i][0], places[i][1], false, clip);
+        image(places[i][0], places[i][1], true, clip);
+        copy(0, 0, places[i][0], places[i][1], clip);
+    }
+
+    //sources off the screen
+    copy(-30, -20, 250, 200, false);
+    copy(SIM_WIDTH - 60, SIM_HEIGHT - 50, 250, 200, false);
+    copy(SIM_WIDTH - 60, SIM_HEIGHT - 50, 250, 200, true);
+}
+
+int main()
+{
+    vga.display_control(RESOLUTION, RES_640X480);
+    vga.background_color(BLACK);
+
+    //the driver has not sent a pen since the reset: the screen's is solid
+    vga.invalidate_state();
+    vga.background_color(BLACK);
+    straddle("reset", true);
+
+    vga.pen_size(SOLID);
+    straddle("solid", true);
+    vga.pen_size(WIREFRAME);
+    straddle("wireframe", false);
+
+    vga.pen_size(SOLID);
+    blocks();
+
+    printf("%d rectangles, copies and images wrong\n", failures);
+    return failures ? 1 : 0;
+}
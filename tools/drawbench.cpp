@@ -0,0 +1,63 @@
+// Host time the driver spends per draw command, on the mock transport.
+//
+//   g++ -O2 -o drawbench tools/drawbench.cpp 4DGL/TFT_4DGL_*.cpp -I4DGL -DTFT_4DGL_HOST=1
+//   ./drawbench [rounds]
+//
+// Draws a fixed mix of rectangles, lines, pixels, circles and characters
+// in batches, as the renderer does, and reports the time per command with
+// the bytes going nowhere. It uses only calls the driver has had since it
+// took a transport, so the same file builds against older trees to
+// compare driver builds, e.g. before and after the transport became a
+// template parameter.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "TFT_4DGL.h"
+
+// Commands drawn per batch
+#define BATCH_COMMANDS  100
+// Runs, the fastest is reported
+#define BENCH_RUNS      5
+
+static TFT_4DGL vga(0, 0, 0, 115200);
+
+static double now_ns()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static void batch(int i)
+{
+    vga.batch_begin();
+    for (int n = 0; n < 20; n++) {
+        int x = (i * 7 + n * 13) % 600;
+        int y = (i * 5 + n * 11) % 440;
+        vga.rectangle(x, y, x + 31, y + 31, 0x00FF00);
+        vga.line(x, y, x + 39, y + 23, 0xFFFFFF);
+        vga.pixel(x, y, 0xFF0000);
+        vga.pixel(x + 1, y, 0xFF0000);
+        vga.graphic_char('0' + n % 10, x, y, 0xFFFFFF, 1, 1);
+    }
+    vga.batch_end();
+}
+
+int main(int argc, char **argv)
+{
+    int rounds = argc > 1 ? atoi(argv[1]) : 20000;
+    double best = 1e18;
+
+    for (int run = 0; run < BENCH_RUNS; run++) {
+        double t = now_ns();
+        for (int i = 0; i < rounds; i++)
+            batch(i);
+        double ns = (now_ns() - t) / ((double)rounds * BATCH_COMMANDS);
+        if (ns < best)
+            best = ns;
+    }
+    printf("%d batches of %d commands, best of %d runs: %.1f ns per command\n",
+           rounds, BATCH_COMMANDS, BENCH_RUNS, best);
+    return 0;
+}
@@ -0,0 +1,80 @@
+// Collisions between snakes in Game::tick(), on the host.
+//
+//   g++ -O2 -o gametest -I. tools/gametest.cpp game.cpp snakebody.cpp
+//   ./gametest
+//
+// Head-on: two snakes run down and up one column from their start rows
+// until their heads meet on the same cell, with either snake above. Both
+// must die, whichever the collision pass looks at first.
+//
+// Swap: two snakes laid out facing each other with their heads next to
+// each other, so each head moves into the cell the other leaves. Neither
+// may pass through the other.
+
+#include <stdio.h>
+#include "game.h"
+
+static int failures;
+
+static void expect(bool ok, const char *what, unsigned int seed)
+{
+    if (!ok) {
+        printf("FAIL %s, seed %u\n", what, seed);
+        failures++;
+    }
+}
+
+// Snakes start on rows 16 and 26 with their heads in one column; the one
+// on row 16 goes down and the other up, meeting on row 21
+static void headOn(unsigned int seed, bool swapRows)
+{
+    Game game;
+    game.reset(2, seed);
+    if (swapRows) {
+        int x = game.snakes[0].body.tailX();
+        game.place(0, x, 26, DIR_RIGHT, game.snakes[0].body.length());
+        game.place(1, x, 16, DIR_RIGHT, game.snakes[1].body.length());
+    }
+    int down = swapRows ? 1 : 0;
+    game.turn(down, DIR_DOWN);
+    game.turn(1 - down, DIR_UP);
+
+    int events = 0;
+    for (int t = 0; t < 5; t++) {
+        expect(game.snakes[0].alive && game.snakes[1].alive, "head-on, died before meeting", seed);
+        events = game.tick();
+    }
+    expect(game.snakes[0].body.headX() == game.snakes[1].body.headX(), "head-on, heads apart", seed);
+    expect(!game.snakes[0].alive && !game.snakes[1].alive,
+           swapRows ? "head-on from below, a snake lived" : "head-on, a snake lived", seed);
+    expect((events & GAME_OVER) && game.over, "head-on, game not over", seed);
+}
+
+// Heads at x 24 and 25 on row 40, facing
+static void swap(unsigned int seed, int length)
+{
+    Game game;
+    game.reset(2, seed);
+    game.place(0, 24 - length + 1, 40, DIR_RIGHT, length);
+    game.place(1, 25 + length - 1, 40, DIR_LEFT, length);
+
+    int events = game.tick();
+    expect(!game.snakes[0].alive && !game.snakes[1].alive, "swap, a snake passed through", seed);
+    expect(game.snakes[0].body.headX() == 24 && game.snakes[1].body.headX() == 25,
+           "swap, a dead snake moved", seed);
+    expect((events & GAME_OVER) && game.over, "swap, game not over", seed);
+}
+
+int main()
+{
+    int cases = 0;
+    for (unsigned int seed = 1; seed <= 100; seed++) {
+        headOn(seed, false);
+        headOn(seed, true);
+        swap(seed, 2);
+        swap(seed, 5);
+        cases += 4;
+    }
+    printf("%d cases, %d failed\n", cases, failures);
+    return failures ? 1 : 0;
+}
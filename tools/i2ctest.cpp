@@ -0,0 +1,137 @@
+// I2cQueue transactions against simulated MPR121s, on the host.
+//
+//   g++ -o i2ctest -I. -DI2C_QUEUE_HOST=1 tools/i2ctest.cpp i2cqueue.cpp mpr121sim.cpp
+//   ./i2ctest
+//
+// Runs the transaction state machine through the bus state codes it meets
+// on the LPC1768: register reads and writes that complete, queued ones
+// finishing in order, an address or data byte not acknowledged, a bus
+// error, and a bus that stops answering, which a blocking transfer must
+// give up on in bounded bus time. After each failure the next transaction must go through.
+
+#include <stdio.h>
+#include <string.h>
+#include "i2cqueue.h"
+#include "mpr121sim.h"
+
+// 8 bit addresses of the two chips on the bus, and one nobody answers
+#define CHIP_A      0xB4
+#define CHIP_B      0xB6
+#define CHIP_NONE   0xBA
+
+static int failures;
+
+static void expect(bool ok, const char *what)
+{
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        failures++;
+    }
+}
+
+struct Done {
+    int order[I2C_QUEUE_MAX];
+    int status[I2C_QUEUE_MAX];
+    int count;
+};
+
+static Done done;
+
+static void record(void *ctx, int status)
+{
+    done.order[done.count] = (int)(long)ctx;
+    done.status[done.count] = status;
+    done.count++;
+}
+
+// Touch status, filtered data and baselines in one read, and back
+static void normal(I2cQueue &q, Mpr121Sim &a)
+{
+    unsigned char regs[0x2B];
+    a.touch(0x0105);
+    expect(q.readSync(CHIP_A, 0x00, regs, sizeof(regs)) == I2C_OK, "read, status");
+    expect(memcmp(regs, a.regs, sizeof(regs)) == 0, "read, registers differ");
+    expect(q.pending() == 0, "read, still pending");
+
+    //1 byte read takes the not acknowledged last byte path only
+    unsigned char one = 0;
+    expect(q.readSync(CHIP_A, 0x5D, &one, 1) == I2C_OK && one == 0x24, "read of one register");
+
+    unsigned char cfg[2] = { 0x0C, 0x8F };
+    expect(q.writeSync(CHIP_A, 0x5E, cfg, 2) == I2C_OK, "write, status");
+    expect(a.regs[0x5E] == 0x0C && a.regs[0x5F] == 0x8F, "write, registers differ");
+
+    //queued transactions run one after the other, callbacks in order
+    unsigned char t[I2C_QUEUE_MAX][2];
+    done.count = 0;
+    for (int i = 0; i < I2C_QUEUE_MAX; i++)
+        expect(q.read(CHIP_A, 0x00, t[i], 2, record, (void *)(long)i), "queue, refused");
+    expect(!q.read(CHIP_A, 0x00, t[0], 2), "queue, accepted past full");
+    while (q.pending())
+        q.poll();
+    expect(done.count == I2C_QUEUE_MAX, "queue, callbacks missing");
+    for (int i = 0; i < done.count; i++)
+        expect(done.order[i] == i && done.status[i] == I2C_OK, "queue, out of order or failed");
+}
+
+static void nack(I2cQueue &q, Mpr121Sim &a, Mpr121Sim &b)
+{
+    unsigned char regs[2];
+    int nacks = q.nacks;
+
+    expect(q.readSync(CHIP_NONE, 0x00, regs, 2) == I2C_NACK, "nack, absent chip");
+
+    a.nackAddress = 1;
+    expect(q.readSync(CHIP_A, 0x00, regs, 2) == I2C_NACK, "nack, address");
+    expect(q.readSync(CHIP_A, 0x00, regs, 2) == I2C_OK, "nack, address, next read");
+
+    unsigned char cfg = 0x10;
+    b.nackData = 1;
+    expect(q.writeSync(CHIP_B, 0x5C, &cfg, 1) == I2C_NACK, "nack, data");
+    expect(q.writeSync(CHIP_B, 0x5C, &cfg, 1) == I2C_OK, "nack, data, next write");
+
+    expect(q.nacks == nacks + 3, "nack, count");
+}
+
+static void timeout(I2cQueue &q, I2cSim &bus, Mpr121Sim &a)
+{
+    unsigned char regs[2];
+    int errors = q.busErrors;
+
+    bus.busError = 1;
+    expect(q.readSync(CHIP_A, 0x00, regs, 2) == I2C_BUS_ERROR, "bus error");
+    expect(q.readSync(CHIP_A, 0x00, regs, 2) == I2C_OK, "bus error, next read");
+
+    //a blocking transfer gives up; queued ones behind it fail with it
+    done.count = 0;
+    bus.stuck = true;
+    expect(q.read(CHIP_A, 0x00, regs, 2, record, (void *)0), "timeout, refused");
+    long t = bus.us;
+    expect(q.readSync(CHIP_A, 0x00, regs, 2) == I2C_BUS_ERROR, "timeout, status");
+    expect(bus.us - t < 2 * I2C_SYNC_MARGIN_US, "timeout, waited too long");
+    expect(q.pending() == 0, "timeout, still pending");
+    expect(done.count == 1 && done.status[0] == I2C_BUS_ERROR, "timeout, queued transaction");
+    bus.stuck = false;
+
+    a.touch(0x0800);
+    expect(q.readSync(CHIP_A, 0x00, regs, 2) == I2C_OK && regs[1] == 0x08, "timeout, next read");
+    expect(q.busErrors == errors + 3, "timeout, count");
+}
+
+int main()
+{
+    I2cSim bus;
+    Mpr121Sim a(CHIP_A), b(CHIP_B);
+    bus.attach(&a);
+    bus.attach(&b);
+    I2cQueue q(&bus);
+    q.frequency(400000);
+
+    normal(q, a);
+    nack(q, a, b);
+    timeout(q, bus, a);
+
+    printf("%d transactions, %d not acknowledged, %d bus errors, %d refused; %d failed\n",
+           q.completed, q.nacks, q.busErrors, q.overflows, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,82 @@
+// Converts a PPM picture into a TFT_4DGL_Image in C arrays, for blit().
+//
+//   g++ -o img2c tools/img2c.cpp -I4DGL -DTFT_4DGL_HOST=1
+//   ./img2c [-f rgb565|palette|rle] banner.ppm banner > banner.h
+//
+// Without -f the smallest format is picked: RLE or palette when the
+// picture has at most 256 colours, RGB565 otherwise. Export the picture
+// from any editor as PPM (P6 or P3).
+
+#include <stdio.h>
+#include <string.h>
+#include "TFT_4DGL.h"
+#include "imgenc.h"
+
+static const char *formatNames[] = { "IMAGE_RGB565", "IMAGE_PALETTE", "IMAGE_RLE" };
+
+static void usage()
+{
+    fprintf(stderr, "usage: img2c [-f rgb565|palette|rle] picture.ppm name > name.h\n");
+}
+
+int main(int argc, char **argv)
+{
+    int format = -1;
+    int arg = 1;
+
+    if (argc > 2 && strcmp(argv[1], "-f") == 0) {
+        if (strcmp(argv[2], "rgb565") == 0)
+            format = IMAGE_RGB565;
+        else if (strcmp(argv[2], "palette") == 0)
+            format = IMAGE_PALETTE;
+        else if (strcmp(argv[2], "rle") == 0)
+            format = IMAGE_RLE;
+        else {
+            usage();
+            return 1;
+        }
+        arg = 3;
+    }
+    if (argc - arg != 2) {
+        usage();
+        return 1;
+    }
+    const char *path = argv[arg];
+    const char *name = argv[arg + 1];
+
+    Picture picture;
+    if (!loadPpm(path, &picture)) {
+        fprintf(stderr, "img2c: %s is not a PPM picture with 8 bit channels\n", path);
+        return 1;
+    }
+    Encoded e;
+    if (!encode(picture, format, &e)) {
+        fprintf(stderr, "img2c: %s has more than 256 colours, use -f rgb565\n", path);
+        return 1;
+    }
+
+    printf("// %s, %dx%d, made by tools/img2c.cpp\n", path, picture.width, picture.height);
+    printf("// %d bytes of data, %d on the wire in 16 bit mode\n\n",
+           (int)(e.data.size() + 2 * e.palette.size()), picture.width * picture.height * 2);
+    printf("#include \"TFT_4DGL.h\"\n\n");
+
+    if (!e.palette.empty()) {
+        printf("static const unsigned short %s_palette[%d] = {", name, (int)e.palette.size());
+        for (size_t i = 0; i < e.palette.size(); i++)
+            printf("%s0x%04X,", (i % 8) ? " " : "\n    ", e.palette[i]);
+        printf("\n};\n\n");
+    }
+    printf("static const unsigned char %s_data[%d] = {", name, (int)e.data.size());
+    for (size_t i = 0; i < e.data.size(); i++)
+        printf("%s0x%02X,", (i % 12) ? " " : "\n    ", e.data[i]);
+    printf("\n};\n\n");
+
+    printf("static const TFT_4DGL_Image %s = {\n", name);
+    printf("    %d, %d, %s, %d,\n", picture.width, picture.height, formatNames[e.format], (int)e.palette.size());
+    if (e.palette.empty())
+        printf("    0,\n");
+    else
+        printf("    %s_palette,\n", name);
+    printf("    %s_data, %d\n};\n", name, (int)e.data.size());
+    return 0;
+}
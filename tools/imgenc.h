@@ -0,0 +1,151 @@
+#ifndef IMGENC_H
+#define IMGENC_H
+
+// Image loading and encoding for the host tools, in the formats blit()
+// decodes (see TFT_4DGL_Image in 4DGL/TFT_4DGL.h). Not built for mbed.
+
+#include <stdio.h>
+#include <vector>
+
+// Picture in RGB565, row by row
+struct Picture
+{
+    int width;
+    int height;
+    std::vector<unsigned short> pixels;
+};
+
+// Encoded image data, as it goes into flash
+struct Encoded
+{
+    int format;                             // IMAGE_ value
+    std::vector<unsigned short> palette;
+    std::vector<unsigned char> data;
+};
+
+static unsigned short rgb565(int r, int g, int b)
+{
+    return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+}
+
+// Next number of a PPM header, skipping blanks and comments
+static int ppmNumber(FILE *f)
+{
+    int c = fgetc(f);
+    while (c == '#' || c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+        if (c == '#')
+            while (c != '\n' && c != EOF)
+                c = fgetc(f);
+        c = fgetc(f);
+    }
+    int n = 0;
+    while (c >= '0' && c <= '9') {
+        n = n * 10 + c - '0';
+        c = fgetc(f);
+    }
+    return n;
+}
+
+// Binary (P6) or text (P3) PPM with 8 bit channels
+static bool loadPpm(const char *path, Picture *p)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+        return false;
+
+    char magic[2] = { 0, 0 };
+    if (fread(magic, 1, 2, f) != 2 || magic[0] != 'P' || (magic[1] != '6' && magic[1] != '3')) {
+        fclose(f);
+        return false;
+    }
+    p->width = ppmNumber(f);
+    p->height = ppmNumber(f);
+    int maxval = ppmNumber(f);
+    if (p->width <= 0 || p->height <= 0 || maxval <= 0 || maxval > 255) {
+        fclose(f);
+        return false;
+    }
+
+    p->pixels.resize(p->width * p->height);
+    for (int i = 0; i < p->width * p->height; i++) {
+        int rgb[3];
+        for (int k = 0; k < 3; k++) {
+            rgb[k] = (magic[1] == '6') ? fgetc(f) : ppmNumber(f);
+            if (rgb[k] < 0) {
+                fclose(f);
+                return false;
+            }
+            rgb[k] = rgb[k] * 255 / maxval;
+        }
+        p->pixels[i] = rgb565(rgb[0], rgb[1], rgb[2]);
+    }
+    fclose(f);
+    return true;
+}
+
+// Palette of the picture and the index of every pixel, false above 256 colours
+static bool buildPalette(const Picture &p, std::vector<unsigned short> *palette, std::vector<unsigned char> *indices)
+{
+    palette->clear();
+    indices->resize(p.pixels.size());
+    for (size_t i = 0; i < p.pixels.size(); i++) {
+        size_t k = 0;
+        while (k < palette->size() && (*palette)[k] != p.pixels[i])
+            k++;
+        if (k == palette->size()) {
+            if (k == 256)
+                return false;
+            palette->push_back(p.pixels[i]);
+        }
+        (*indices)[i] = k;
+    }
+    return true;
+}
+
+// Encode in a format, or the smallest one when format is -1. False when the
+// picture has too many colours for the format asked.
+static bool encode(const Picture &p, int format, Encoded *e)
+{
+    std::vector<unsigned char> indices;
+    bool paletted = buildPalette(p, &e->palette, &indices);
+
+    if (format < 0 && !paletted) {
+        format = IMAGE_RGB565;
+    } else if (format < 0) {
+        //runs only pay off when they are long enough
+        encode(p, IMAGE_RLE, e);
+        if (e->data.size() < indices.size())
+            return true;
+        format = IMAGE_PALETTE;
+    }
+    if (format != IMAGE_RGB565 && !paletted)
+        return false;
+
+    e->format = format;
+    e->data.clear();
+    switch (format) {
+        case IMAGE_RGB565:
+            e->palette.clear();
+            for (size_t i = 0; i < p.pixels.size(); i++) {
+                e->data.push_back(p.pixels[i] >> 8);
+                e->data.push_back(p.pixels[i] & 0xFF);
+            }
+            break;
+        case IMAGE_PALETTE:
+            e->data = indices;
+            break;
+        case IMAGE_RLE:
+            for (size_t i = 0; i < indices.size(); ) {
+                size_t run = 1;
+                while (i + run < indices.size() && run < 255 && indices[i + run] == indices[i])
+                    run++;
+                e->data.push_back(run);
+                e->data.push_back(indices[i]);
+                i += run;
+            }
+            break;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,355 @@
+// Two boards playing one game over a serial link, as two processes joined
+// by a pseudo-terminal pair, with the link made late, lossy and noisy.
+//
+//   g++ -O2 -o linkplay -I. -I4DGL -DTFT_4DGL_HOST=1 -DTFT_4DGL_TRANSPORT=SimTransport
+//       -DRENDER_VERIFY=1 tools/linkplay.cpp linkplay.cpp replay.cpp game.cpp
+//       snakebody.cpp autopilot.cpp renderer.cpp rectbatch.cpp tilecache.cpp 4DGL/TFT_4DGL_*.cpp
+//   ./linkplay [-n ticks] [-t tick us] [-l latency ms] [-j jitter ms] [-p loss %]
+//              [-c corrupt %] [-b baud] [-s seed]
+//
+// Each process is a board: the autopilot steers its snake, LinkPlay runs
+// the game and the link. Packets leave after the latency plus up to the
+// jitter, in order and no faster than the baud rate, and are dropped or
+// get a bit flipped at the given rates. The first board also draws every
+// tick into the display simulator, repairing the screen after rollbacks,
+// and checks the screen against the game.
+//
+// At the end both boards must hold the same agreed game, and the game each
+// recorded must replay to it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/wait.h>
+#include "linkplay.h"
+#include "autopilot.h"
+#include "renderer.h"
+
+// Longest a board waits for the other before giving up, and lingers after
+// the end so the other board hears it
+#define WAIT_LIMIT_MS   3000
+#define LINGER_MS       300
+// Packets queued for the delay line
+#define DELAY_PACKETS   256
+
+struct Options {
+    int ticks;
+    int tickUs;
+    int latencyMs;
+    int jitterMs;
+    int lossPct;
+    int corruptPct;
+    int baud;
+    unsigned int seed;
+};
+
+struct Result {
+    int agreed;
+    unsigned int checksum;
+    bool replayOk;
+    bool over;
+};
+
+// Outgoing side of a board: a delay line in front of the file descriptor
+struct Line {
+    int fd;
+    const Options *opt;
+    unsigned char data[DELAY_PACKETS][LINK_PACKET];
+    int size[DELAY_PACKETS];
+    double due[DELAY_PACKETS];
+    int head;
+    int tail;
+    double free;        // when the line has sent what it was given
+    int lost;
+    int corrupted;
+};
+
+static double now_ms()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e3 + t.tv_nsec * 1e-6;
+}
+
+static int percent()
+{
+    return rand() % 100;
+}
+
+static int readByte(void *ctx)
+{
+    Line *line = (Line *)ctx;
+    unsigned char c;
+    return read(line->fd, &c, 1) == 1 ? c : -1;
+}
+
+static void writePacket(void *ctx, const unsigned char *data, int size)
+{
+    Line *line = (Line *)ctx;
+    const Options *opt = line->opt;
+    if (percent() < opt->lossPct) {
+        line->lost++;
+        return;
+    }
+    int next = (line->head + 1) % DELAY_PACKETS;
+    if (next == line->tail) {
+        line->lost++;
+        return;
+    }
+
+    memcpy(line->data[line->head], data, size);
+    if (percent() < opt->corruptPct) {
+        line->data[line->head][rand() % size] ^= 1 << (rand() % 8);
+        line->corrupted++;
+    }
+    line->size[line->head] = size;
+
+    //a serial line keeps the order and sends a byte in 10 bit times
+    double due = now_ms() + opt->latencyMs + (opt->jitterMs ? rand() % (opt->jitterMs + 1) : 0);
+    if (due < line->free)
+        due = line->free;
+    line->free = due + size * 10 * 1000.0 / opt->baud;
+    line->due[line->head] = line->free;
+    line->head = next;
+}
+
+static void pump(Line *line)
+{
+    double now = now_ms();
+    while (line->tail != line->head && line->due[line->tail] <= now) {
+        if (write(line->fd, line->data[line->tail], line->size[line->tail]) < 0)
+            return;
+        line->tail = (line->tail + 1) % DELAY_PACKETS;
+    }
+}
+
+static Game game;
+static Autopilot pilot;
+static Replay record;
+static Game check;
+static Replay playback;
+
+static TFT_4DGL vga(0, 0, 0, 115200);
+static Renderer renderer(&vga, 0);
+
+static void bodies(const SnakeBody **b)
+{
+    for (int i = 0; i < game.players; i++)
+        b[i] = &game.snakes[i].body;
+}
+
+// What the tick task draws after a tick, or the repair after a rollback
+static int draw(bool rewound, int events)
+{
+    const SnakeBody *b[GAME_MAX_SNAKES];
+    bodies(b);
+    if (rewound) {
+        renderer.repair(b, game.players, game.foodx, game.foody);
+    } else if (events >= 0) {
+        for (int i = 0; i < game.players; i++)
+            if (game.snakes[i].tailx >= 0)
+                renderer.cell(game.snakes[i].tailx, game.snakes[i].taily, BLACK);
+        for (int i = 0; i < game.players; i++) {
+            const Snake &s = game.snakes[i];
+            if (s.tailx >= 0 || (s.events & GAME_ATE))
+                renderer.head(i, s.body.headX(), s.body.headY(), s.heading);
+        }
+        if ((events & GAME_ATE) && game.foodx >= 0)
+            renderer.apple(game.foodx, game.foody);
+    }
+    renderer.flush();
+    return renderer.verify(b, game.players, game.foodx, game.foody);
+}
+
+static void startScreen()
+{
+    vga.display_control(RESOLUTION, RES_640X480);
+    vga.background_color(BLACK);
+    vga.cls();
+    renderer.invalidate();
+    const SnakeBody *b[GAME_MAX_SNAKES];
+    bodies(b);
+    renderer.resync(b, game.players, game.foodx, game.foody, false);
+    renderer.flush();
+}
+
+static Result board(int id, int fd, const Options &opt)
+{
+    static Line line;
+    memset(&line, 0, sizeof(line));
+    line.fd = fd;
+    line.opt = &opt;
+    srand(opt.seed * 2 + id);
+
+    LinkPlay link(readByte, writePacket, &line);
+    link.begin(opt.seed * 2 + id + 1, &record);
+
+    bool drawing = id == 0;
+    bool screen = false;
+    int drift = 0, turns = 0, onTime = 0;
+    double next = now_ms();
+    double heard = next;
+    double ended = 0;
+    int lastReceived = 0;
+
+    for (;;) {
+        if (link.poll(game) && screen)
+            drift += draw(true, -1);
+        pump(&line);
+        double now = now_ms();
+
+        if (link.received != lastReceived) {
+            lastReceived = link.received;
+            heard = now;
+        }
+        if (now - heard > WAIT_LIMIT_MS)
+            break;
+
+        //the end once the agreed game reached it and the other board has
+        //every input of it, then a little longer for its acknowledgements
+        int end = link.over() ? link.confirmedTicks : opt.ticks;
+        if (link.connected() && link.confirmedTicks >= end && link.settled(end)) {
+            if (!ended)
+                ended = now;
+            else if (now - ended > LINGER_MS)
+                break;
+        }
+
+        if (now < next) {
+            usleep(100);
+            continue;
+        }
+        next += opt.tickUs / 1000.0;
+
+        if (!link.connected() || link.ticks >= opt.ticks) {
+            link.idle();
+            continue;
+        }
+        if (drawing && !screen) {
+            startScreen();
+            screen = true;
+        }
+
+        //the autopilot steers on the game as this board predicts it
+        int local = link.local();
+        pilot.reset(game);
+        int heading = pilot.choose(game, local);
+        bool steered = heading != game.snakes[local].heading && link.steer(game, heading);
+
+        //a game predicted over does not move until the rollback
+        int events = link.tick(game);
+        if (steered && events >= 0 && !(events & GAME_OVER)) {
+            turns++;
+            if (game.snakes[local].heading == heading)
+                onTime++;
+        }
+        if (screen)
+            drift += draw(false, events);
+    }
+
+    Result r;
+    r.agreed = link.confirmedTicks;
+    r.checksum = link.agreed().checksum();
+    r.over = link.over();
+
+    //the recorded game plays back to the agreed one
+    record.finish(link.agreed());
+    r.replayOk = playback.load(record.data(), record.size()) && playback.begin(check);
+    while (r.replayOk && playback.step(check))
+        ;
+    r.replayOk = r.replayOk && playback.matches(check);
+
+    printf("board %d, snake %d: %d ticks, %d agreed%s, checksum %08x, replay %s\n", id, link.local(),
+           link.ticks, link.confirmedTicks, r.over ? " (over)" : "", r.checksum,
+           r.replayOk ? "same" : "DIFFERENT");
+    printf("  %d rollbacks, %.1f ticks again each, %d most; %d stalls; %d of %d own turns on the next tick\n",
+           link.rollbacks, link.rollbacks ? (double)link.resimulated / link.rollbacks : 0.0,
+           link.maxRollback, link.stalls, onTime, turns);
+    printf("  %d packets sent (%d lost, %d corrupted), %d received, %d bad; %d checksums, %d differ\n",
+           link.sent, line.lost, line.corrupted, link.received, link.badPackets, link.checks,
+           link.desyncs);
+    if (drawing)
+        printf("  screen: %d repairs, %d cells drifted from the game\n", link.rollbacks, drift);
+    fflush(stdout);
+    return r;
+}
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    opt.ticks = 1200;
+    opt.tickUs = 16500;
+    opt.latencyMs = 30;
+    opt.jitterMs = 10;
+    opt.lossPct = 5;
+    opt.corruptPct = 1;
+    opt.baud = 115200;
+    opt.seed = 1;
+
+    for (int a = 1; a < argc; a++) {
+        int v = a + 1 < argc ? atoi(argv[a + 1]) : 0;
+        if (strcmp(argv[a], "-n") == 0) opt.ticks = v;
+        else if (strcmp(argv[a], "-t") == 0) opt.tickUs = v;
+        else if (strcmp(argv[a], "-l") == 0) opt.latencyMs = v;
+        else if (strcmp(argv[a], "-j") == 0) opt.jitterMs = v;
+        else if (strcmp(argv[a], "-p") == 0) opt.lossPct = v;
+        else if (strcmp(argv[a], "-c") == 0) opt.corruptPct = v;
+        else if (strcmp(argv[a], "-b") == 0) opt.baud = v;
+        else if (strcmp(argv[a], "-s") == 0) opt.seed = v;
+        else {
+            printf("usage: linkplay [-n ticks] [-t tick us] [-l latency ms] [-j jitter ms] "
+                   "[-p loss %%] [-c corrupt %%] [-b baud] [-s seed]\n");
+            return 2;
+        }
+        a++;
+    }
+
+    //a raw pseudo-terminal pair stands for the cable
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+        perror("pty");
+        return 1;
+    }
+    int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    struct termios tio;
+    if (slave < 0 || tcgetattr(slave, &tio) < 0) {
+        perror("pty");
+        return 1;
+    }
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+    fcntl(master, F_SETFL, O_NONBLOCK);
+    fcntl(slave, F_SETFL, O_NONBLOCK);
+
+    printf("%d ticks of %d us, latency %d ms + up to %d, %d%% lost, %d%% corrupted, %d baud\n",
+           opt.ticks, opt.tickUs, opt.latencyMs, opt.jitterMs, opt.lossPct, opt.corruptPct, opt.baud);
+    fflush(stdout);
+
+    int results[2];
+    if (pipe(results) < 0) {
+        perror("pipe");
+        return 1;
+    }
+    pid_t child = fork();
+    if (child == 0) {
+        close(master);
+        Result r = board(1, slave, opt);
+        if (write(results[1], &r, sizeof(r)) != sizeof(r))
+            return 1;
+        return 0;
+    }
+    close(slave);
+    Result mine = board(0, master, opt);
+    Result other;
+    int status;
+    bool got = read(results[0], &other, sizeof(other)) == sizeof(other);
+    waitpid(child, &status, 0);
+
+    bool same = got && mine.agreed == other.agreed && mine.checksum == other.checksum;
+    printf("%s after %d ticks\n", same ? "boards agree" : "boards DIFFER", mine.agreed);
+    return same && mine.replayOk && other.replayOk ? 0 : 1;
+}
@@ -0,0 +1,103 @@
+// I2C bus time of the keypads, with 1 to 4 simulated MPR121s, on the host.
+//
+//   g++ -O2 -o padbench -I. -DI2C_QUEUE_HOST=1 tools/padbench.cpp controllers.cpp
+//       mpr121.cpp i2cqueue.cpp mpr121sim.cpp
+//   ./padbench [frames]
+//
+// For each number of chips and bus setting, ControllerManager::scan()
+// finds and configures the chips, then runs frames of the tick period
+// with poll() at the input task period, as main() does. Every third frame
+// each keypad's touches change and the shared IRQ line falls.
+//
+// Reported: the bus time of the scan, the bus time per frame, average and
+// worst, against I2C_FRAME_BUDGET_US, the times poll() left a flagged chip
+// for a later frame for lack of budget, and the touch changes that reached
+// the player queues.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "controllers.h"
+#include "mpr121sim.h"
+
+// Task periods from main(), in us
+#define INPUT_US        2000
+#define TICK_US         16500
+
+// 8 bit addresses in the order scan() probes them
+static const int addresses[MAX_PLAYERS] = {
+    Mpr121::ADD_VSS, Mpr121::ADD_VDD, Mpr121::ADD_SCL, Mpr121::ADD_SDA
+};
+
+struct Setting {
+    int hz;
+    bool electrodeData;
+};
+
+static const Setting settings[] = {
+    { 400000, false },
+    { 100000, false },
+    { 400000, true },
+};
+#define SETTINGS        (int)(sizeof(settings) / sizeof(settings[0]))
+
+static void run(int chips, const Setting &s, int frames)
+{
+    I2cSim bus;
+    Mpr121Sim *sims[MAX_PLAYERS];
+    for (int i = 0; i < chips; i++) {
+        sims[i] = new Mpr121Sim(addresses[i]);
+        bus.attach(sims[i]);
+    }
+    I2cQueue q(&bus);
+    q.frequency(s.hz);
+    ControllerManager m(&q);
+    m.readElectrodeData(s.electrodeData);
+
+    long t = bus.us;
+    int found = m.scan();
+    long scanUs = bus.us - t;
+
+    long total = 0, worst = 0;
+    int changes = 0, seen = 0;
+    for (int f = 0; f < frames; f++) {
+        m.frame();
+        long start = bus.us;
+        if (f % 3 == 0) {
+            for (int i = 0; i < chips; i++)
+                sims[i]->touch((f / 3 + i) % 2 ? 1 << (f % 12) : 0);
+            m.irq();
+            changes += chips;
+        }
+        for (int p = 0; p < TICK_US / INPUT_US; p++) {
+            m.poll();
+            q.poll();
+            for (int i = 0; i < found; i++)
+                while (m.next(i) >= 0)
+                    seen++;
+        }
+        long us = bus.us - start;
+        total += us;
+        if (us > worst)
+            worst = us;
+    }
+
+    printf("%5d  %4d kHz  %-9s  %6ld  %8.0f  %5ld  %8d  %6d/%d\n", found, s.hz / 1000,
+           s.electrodeData ? "42 bytes" : "2 bytes", scanUs, (double)total / frames, worst,
+           m.deferred, seen, changes);
+
+    for (int i = 0; i < chips; i++)
+        delete sims[i];
+}
+
+int main(int argc, char **argv)
+{
+    int frames = argc > 1 ? atoi(argv[1]) : 3000;
+
+    printf("%d frames of %d us, budget %d us of bus time per frame\n\n", frames, TICK_US,
+           I2C_FRAME_BUDGET_US);
+    printf("chips  bus       read       scan us  frame us  worst  deferred  changes seen\n");
+    for (int s = 0; s < SETTINGS; s++)
+        for (int chips = 1; chips <= MAX_PLAYERS; chips++)
+            run(chips, settings[s], frames);
+    return 0;
+}
@@ -0,0 +1,115 @@
+// Commands sent by a full redraw, by snake length, on the host simulator.
+//
+//   g++ -O2 -o redrawbench -I. -I4DGL -DTFT_4DGL_HOST=1 -DTFT_4DGL_TRANSPORT=SimTransport
+//       tools/redrawbench.cpp game.cpp snakebody.cpp autopilot.cpp renderer.cpp
+//       tilecache.cpp rectbatch.cpp 4DGL/TFT_4DGL_*.cpp
+//   ./redrawbench [games]
+//
+// The autopilot plays one snake games. The first time the snake reaches
+// each length below, the field is redrawn with Renderer::resync() and the
+// body rectangles, the draw commands and what reached the simulated screen
+// are counted. For comparison, a body drawn one command per segment, as
+// the game started, or one per straight run, as before the rectangle
+// cover, would take the segment and run counts.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "autopilot.h"
+#include "renderer.h"
+
+// Games stop after this many ticks
+#define BENCH_TICKS     20000
+// Lengths redrawn at
+static const int lengths[] = { 30, 60, 100, 150, 200, 250, 300 };
+#define LENGTHS         (int)(sizeof(lengths) / sizeof(lengths[0]))
+
+struct Sample {
+    int redraws;
+    long segments;
+    long runs;
+    long rects;
+    long commands;
+    long sent;
+    long bytes;
+};
+
+static Game game;
+static Autopilot pilot;
+static TFT_4DGL vga(0, 0, 0, 115200);
+static Renderer renderer(&vga, 0);
+
+// Straight runs of the body, head to tail
+static int runs(const SnakeBody &body)
+{
+    int n = 0, dx = 0, dy = 0;
+    SnakeBody::iterator it = body.begin();
+    int x = it.x, y = it.y;
+    for (it.next(); !it.done(); it.next()) {
+        if (it.x - x != dx || it.y - y != dy || n == 0)
+            n++;
+        dx = it.x - x;
+        dy = it.y - y;
+        x = it.x;
+        y = it.y;
+    }
+    return n ? n : 1;
+}
+
+static void redraw(Sample &s)
+{
+    const SnakeBody *b[1] = { &game.snakes[0].body };
+    int commands = renderer.commands;
+    int sent = vga.transport().commands;
+    int bytes = vga.transport().bytes;
+
+    renderer.resync(b, 1, game.foodx, game.foody, true);
+    renderer.flush();
+
+    s.redraws++;
+    s.segments += b[0]->length();
+    s.runs += runs(*b[0]);
+    s.rects += renderer.bodyRects;
+    s.commands += renderer.commands - commands;
+    s.sent += vga.transport().commands - sent;
+    s.bytes += vga.transport().bytes - bytes;
+}
+
+int main(int argc, char **argv)
+{
+    int games = argc > 1 ? atoi(argv[1]) : 20;
+    Sample samples[LENGTHS];
+    memset(samples, 0, sizeof(samples));
+
+    vga.display_control(RESOLUTION, RES_640X480);
+    vga.background_color(BLACK);
+
+    for (int g = 0; g < games; g++) {
+        game.reset(1, g + 1);
+        pilot.reset(game);
+        int next = 0;
+
+        for (int t = 0; t < BENCH_TICKS && !game.over && next < LENGTHS; t++) {
+            if (game.snakes[0].body.length() >= lengths[next])
+                redraw(samples[next++]);
+
+            int h = pilot.choose(game, 0);
+            if (h != game.snakes[0].heading)
+                game.turn(0, h);
+            game.tick();
+            pilot.update(game);
+        }
+    }
+
+    printf("%d games, full redraws with the field cleared\n\n", games);
+    printf("length  redraws  segments  runs  body rects  draw commands  sent  bytes\n");
+    for (int i = 0; i < LENGTHS; i++) {
+        const Sample &s = samples[i];
+        if (!s.redraws)
+            continue;
+        double n = s.redraws;
+        printf("%6d  %7d  %8.0f  %4.0f  %10.1f  %13.1f  %4.1f  %5.0f\n", lengths[i], s.redraws,
+               s.segments / n, s.runs / n, s.rects / n, s.commands / n, s.sent / n, s.bytes / n);
+    }
+    return 0;
+}
@@ -0,0 +1,267 @@
+// Plays a game replay back on the host, checks it ends in the recorded
+// state, and times the simulation; optionally draws every tick through the
+// renderer into the display simulator.
+//
+//   g++ -O2 -o replay -I. -I4DGL -DTFT_4DGL_HOST=1 -DTFT_4DGL_TRANSPORT=SimTransport
+//       tools/replay.cpp replay.cpp game.cpp snakebody.cpp autopilot.cpp
+//       renderer.cpp tilecache.cpp rectbatch.cpp 4DGL/TFT_4DGL_*.cpp
+//   ./replay [-n runs] [-r frame.ppm] LAST.RPL
+//   ./replay -d seed [players] out.rpl
+//
+// The replay is the LAST.RPL file from the mbed drive, or a serial log with
+// the "replay <hex>" line main() prints when the drive cannot be written.
+// -d records a game played by the autopilot instead, e.g. as a regression
+// input. With -r the frame checksum at the end tells whether a change to
+// the drawing code changed what is on screen.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "replay.h"
+#include "autopilot.h"
+#include "renderer.h"
+#include "tilecache.h"
+
+// Link speed main() uses
+#define REPLAY_BAUD     115200
+
+static Game game;
+static Replay replay;
+static Autopilot autopilot;
+static unsigned char file[REPLAY_BUFFER * 3];
+
+static TFT_4DGL vga(0, 0, 0, REPLAY_BAUD);
+static TileCache tiles(&vga, 627, 24, 9, 432);
+static Renderer renderer(&vga, &tiles);
+
+static double now_s()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+static int hex(int c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+// The binary file, or the bytes of the first "replay <hex>" line of a log
+static int readReplay(const char *name, unsigned char *data, int max)
+{
+    FILE *f = fopen(name, "rb");
+    if (!f)
+        return -1;
+    static char text[REPLAY_BUFFER * 8];
+    int n = fread(text, 1, sizeof(text) - 1, f);
+    fclose(f);
+    text[n] = 0;
+
+    if (n >= 4 && memcmp(text, "SNKR", 4) == 0) {
+        if (n > max)
+            n = max;
+        memcpy(data, text, n);
+        return n;
+    }
+
+    for (char *p = text; (p = strstr(p, "replay ")) != 0; p += 7) {
+        int size = 0;
+        for (char *h = p + 7; hex(h[0]) >= 0 && hex(h[1]) >= 0 && size < max; h += 2)
+            data[size++] = hex(h[0]) << 4 | hex(h[1]);
+        if (size >= REPLAY_HEADER)
+            return size;
+    }
+    return 0;
+}
+
+// Score digits of a player, as main() draws them
+static void drawScore(int player)
+{
+    int points = game.snakes[player].points;
+    int x = 9*8 + player*4*8;
+
+    tiles.draw(TILE_DIGIT + points%10, x, 8);
+    if (points > 9)
+        tiles.draw(TILE_DIGIT + (points/10)%10, x - 8, 8);
+}
+
+// What main()'s tick task draws after a tick
+static void drawTick(int events)
+{
+    for (int i = 0; i < game.players; i++) {
+        const Snake &s = game.snakes[i];
+        if (s.tailx >= 0)
+            renderer.cell(s.tailx, s.taily, BLACK);
+    }
+    for (int i = 0; i < game.players; i++) {
+        const Snake &s = game.snakes[i];
+        if (s.events & GAME_ATE)
+            drawScore(i);
+        if (s.tailx >= 0 || (s.events & GAME_ATE))
+            renderer.head(i, s.body.headX(), s.body.headY(), s.heading);
+    }
+    if ((events & GAME_ATE) && game.foodx >= 0)
+        renderer.apple(game.foodx, game.foody);
+    renderer.flush();
+}
+
+static void startScreen()
+{
+    vga.display_control(RESOLUTION, RES_640X480);
+    vga.background_color(BLACK);
+    vga.set_font(FONT_8X8);
+    vga.text_mode(TRANSPARENT);
+    vga.cls();
+    tiles.invalidate();
+    tiles.preload();
+    renderer.invalidate();
+    vga.text_string("SCORE:", 2, 1, FONT_8X8, WHITE);
+    for (int i = 0; i < game.players; i++)
+        drawScore(i);
+
+    const SnakeBody *bodies[GAME_MAX_SNAKES];
+    for (int i = 0; i < game.players; i++)
+        bodies[i] = &game.snakes[i].body;
+    renderer.resync(bodies, game.players, game.foodx, game.foody, false);
+    renderer.flush();
+}
+
+static void writeFrame(const char *name)
+{
+    FILE *f = fopen(name, "wb");
+    if (!f)
+        return;
+    fprintf(f, "P6\n%d %d\n255\n", SIM_WIDTH, SIM_HEIGHT);
+    for (int y = 0; y < SIM_HEIGHT; y++) {
+        for (int x = 0; x < SIM_WIDTH; x++) {
+            unsigned short c = vga.transport().frame[y][x];
+            fputc((c >> 11) << 3, f);
+            fputc(((c >> 5) & 0x3F) << 2, f);
+            fputc((c & 0x1F) << 3, f);
+        }
+    }
+    fclose(f);
+}
+
+static unsigned int frameChecksum()
+{
+    unsigned int h = 2166136261u;
+    for (int y = 0; y < SIM_HEIGHT; y++)
+        for (int x = 0; x < SIM_WIDTH; x++)
+            h = (h ^ vga.transport().frame[y][x]) * 16777619u;
+    return h;
+}
+
+// An autopilot game, recorded like main() does
+static int record(unsigned int seed, int players, const char *name)
+{
+    game.reset(players, seed);
+    autopilot.reset(game);
+    replay.start(game);
+    while (!game.over) {
+        for (int i = 0; i < game.players; i++) {
+            int heading = autopilot.choose(game, i);
+            if (heading != game.snakes[i].heading && game.turn(i, heading))
+                replay.turn(i, heading);
+        }
+        game.tick();
+        replay.tick();
+        autopilot.update(game);
+    }
+    replay.finish(game);
+
+    FILE *f = fopen(name, "wb");
+    if (!f) {
+        printf("cannot write %s\n", name);
+        return 1;
+    }
+    fwrite(replay.data(), 1, replay.size(), f);
+    fclose(f);
+    printf("seed %u, %d players: %d ticks, %d turns, %d bytes%s, checksum %08x\n", seed, players,
+           replay.ticks, replay.turns, replay.size(), replay.truncated() ? " (cut short)" : "",
+           game.checksum());
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    int runs = 1;
+    const char *frame = 0;
+    int a = 1;
+
+    if (argc > 3 && strcmp(argv[1], "-d") == 0) {
+        int players = argc > 4 ? atoi(argv[3]) : 1;
+        return record(strtoul(argv[2], 0, 0), players, argv[argc - 1]);
+    }
+    for (; a < argc - 1; a++) {
+        if (strcmp(argv[a], "-n") == 0 && a + 1 < argc - 1)
+            runs = atoi(argv[++a]);
+        else if (strcmp(argv[a], "-r") == 0 && a + 1 < argc - 1)
+            frame = argv[++a];
+    }
+    if (a != argc - 1) {
+        printf("usage: replay [-n runs] [-r frame.ppm] file | replay -d seed [players] file\n");
+        return 2;
+    }
+
+    int size = readReplay(argv[a], file, sizeof(file));
+    if (size <= 0 || !replay.load(file, size)) {
+        printf("%s: not a replay\n", argv[a]);
+        return 1;
+    }
+
+    //re-simulation alone, as fast as the host goes
+    double t0 = now_s();
+    for (int r = 0; r < runs; r++) {
+        replay.begin(game);
+        while (replay.step(game))
+            ;
+    }
+    double s = now_s() - t0;
+    bool same = replay.matches(game);
+    printf("seed %u, %d players, %d bytes: %d ticks, %d turns, score", replay.seed,
+           replay.players, size, replay.ticks, replay.turns);
+    for (int i = 0; i < game.players; i++)
+        printf(" %d", game.snakes[i].points);
+    printf("\n%s, checksum %08x\n", !replay.ended() ? "cut short, not checked" :
+           same ? "same end state" : "DIFFERENT end state", game.checksum());
+    printf("%.0f ticks/s re-simulated (%d runs)\n", replay.ticks * runs / s, runs);
+
+    if (frame) {
+        //once more through the renderer and the display simulator
+        replay.begin(game);
+        startScreen();
+        long start = vga.transport().bytes;
+        long most = 0;
+        int ticks = 0;
+        t0 = now_s();
+        for (;;) {
+            long before = vga.transport().bytes;
+            if (!replay.step(game))
+                break;
+            int events = 0;
+            for (int i = 0; i < game.players; i++)
+                events |= game.snakes[i].events;
+            drawTick(events);
+            ticks++;
+            if (vga.transport().bytes - before > most)
+                most = vga.transport().bytes - before;
+        }
+        s = now_s() - t0;
+        long bytes = vga.transport().bytes - start;
+        printf("rendered %d ticks in %.2f s: %ld bytes, %.1f per tick, %ld max, "
+               "%.2f ms of link per tick at %d baud\n", ticks, s, bytes,
+               ticks ? (double)bytes / ticks : 0.0, most,
+               ticks ? bytes * 10.0 * 1000 / REPLAY_BAUD / ticks : 0.0, REPLAY_BAUD);
+        printf("frame checksum %08x, written to %s\n", frameChecksum(), frame);
+        writeFrame(frame);
+    }
+    return same || !replay.ended() ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+// Time from a finger on a keypad to the tick that moves the snake that way,
+// through the simulated MPR121, I2C queue, controller manager, touch
+// decoder and game, with the task periods main() uses.
+//
+//   g++ -o turnlat -I. -DI2C_QUEUE_HOST=1 tools/turnlat.cpp game.cpp snakebody.cpp
+//       touchpad.cpp controllers.cpp mpr121.cpp i2cqueue.cpp mpr121sim.cpp
+//   ./turnlat [trials]
+//
+// Each trial starts a game heading right and, at a random point of a
+// tick, either presses down, or taps down and then left 8 ms later, inside
+// one tick. It runs once with the turn queue and once steering the old way,
+// with the last key seen before each tick.
+//
+// A turn is on time when the first tick that could take it does: the one
+// after the press, or after the tick that made the turn before it.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "game.h"
+#include "controllers.h"
+#include "mpr121sim.h"
+#include "touchpad.h"
+
+// Task periods from main(), in us
+#define INPUT_US        2000
+#define TICK_US         16500
+// Keys held, and the gap between the two taps of a double turn, in us
+#define TAP_US          6000
+#define HOLD_US         40000
+#define GAP_US          2000
+// Ticks after which a turn not made counts as lost
+#define LOST_TICKS      8
+
+static long now_us;
+
+static uint32_t clock_us()
+{
+    return (uint32_t)now_us;
+}
+
+struct Result {
+    int turns;
+    int lost;
+    int onTime;         // made on the first tick that could take it
+    long total_us;
+    long max_us;
+    long maxLate_us;    // past that tick
+};
+
+// Touches of one trial: electrode mask from a time on
+struct Step {
+    long at;
+    int mask;
+};
+
+static int add(Step *steps, int count, long at, int mask)
+{
+    steps[count].at = at;
+    steps[count].mask = mask;
+    return count + 1;
+}
+
+static void run(bool queued, int trials, Result *r)
+{
+    r->turns = r->lost = r->onTime = 0;
+    r->total_us = r->max_us = r->maxLate_us = 0;
+    srand(1);
+
+    for (int t = 0; t < trials; t++) {
+        I2cSim bus;
+        Mpr121Sim chip(Mpr121::ADD_VSS);
+        bus.attach(&chip);
+        I2cQueue q(&bus);
+        q.frequency(400000);
+        ControllerManager m(&q);
+        m.scan();
+        TouchDecoder decoder(&keypadLayout, clock_us);
+        Game game;
+        game.reset(1);
+
+        bool pair = t & 1;
+        long start = TICK_US * 2 + rand() % TICK_US;
+        Step steps[4];
+        int count = 0;
+        long press[2];
+        int want[2];
+        press[0] = start;
+        want[0] = DIR_DOWN;
+        if (pair) {
+            count = add(steps, count, start, 1 << 5);
+            count = add(steps, count, start + TAP_US, 0);
+            press[1] = start + TAP_US + GAP_US;
+            want[1] = DIR_LEFT;
+            count = add(steps, count, press[1], 1 << 4);
+            count = add(steps, count, press[1] + HOLD_US, 0);
+        } else {
+            count = add(steps, count, start, 1 << 5);
+            count = add(steps, count, start + HOLD_US, 0);
+        }
+        int turns = pair ? 2 : 1;
+
+        long made[2] = { -1, -1 };
+        int step = 0, lastKey = 0, latched = 0, done = 0;
+        long nextInput = 0, nextTick = TICK_US;
+        long end = start + (LOST_TICKS + 2) * TICK_US;
+
+        for (now_us = 0; now_us < end; ) {
+            //touches land at their time, the chips' IRQ line with them
+            while (step < count && steps[step].at <= now_us) {
+                chip.touch(steps[step++].mask);
+                m.irq();
+            }
+
+            if (now_us >= nextInput) {
+                m.poll();
+                q.poll();
+                int value;
+                while ((value = m.next(0)) >= 0) {
+                    decoder.update(value, clock_us());
+                    int key = decoder.key();
+                    if (queued && key && key != lastKey)
+                        game.steer(0, key);
+                    if (key)
+                        latched = key;
+                    lastKey = key;
+                }
+                decoder.tick(clock_us());
+                nextInput += INPUT_US;
+            }
+
+            if (now_us >= nextTick) {
+                if (!queued) {
+                    game.steer(0, latched);
+                    latched = 0;
+                }
+                game.tick();
+                m.frame();
+                int h = game.snakes[0].heading;
+                if (done < turns && h == want[done] && now_us >= press[done])
+                    made[done++] = now_us;
+                nextTick += TICK_US;
+            }
+
+            long next = nextInput < nextTick ? nextInput : nextTick;
+            if (step < count && steps[step].at < next)
+                next = steps[step].at;
+            now_us = next;
+        }
+
+        for (int n = 0; n < turns; n++) {
+            r->turns++;
+            if (made[n] < 0) {
+                r->lost++;
+                continue;
+            }
+            long us = made[n] - press[n];
+            r->total_us += us;
+            if (us > r->max_us)
+                r->max_us = us;
+            //ticks run on multiples of TICK_US: the best case is the first one
+            //after the press, and after the tick that made the turn before
+            long best = (press[n] / TICK_US + 1) * TICK_US;
+            if (n > 0 && made[n - 1] + TICK_US > best)
+                best = made[n - 1] + TICK_US;
+            if (made[n] == best)
+                r->onTime++;
+            if (made[n] - best > r->maxLate_us)
+                r->maxLate_us = made[n] - best;
+        }
+    }
+}
+
+static void print(const char *name, const Result &r)
+{
+    int made = r.turns - r.lost;
+    printf("%-8s %5d turns, %4d lost, %5.1f%% on time, %d late by %ld ticks at most, %5.1f ms average, %5.1f ms max\n",
+           name, r.turns, r.lost, made ? 100.0 * r.onTime / made : 0.0, made - r.onTime,
+           r.maxLate_us / TICK_US, made ? r.total_us / 1000.0 / made : 0.0, r.max_us / 1000.0);
+}
+
+int main(int argc, char **argv)
+{
+    int trials = argc > 1 ? atoi(argv[1]) : 400;
+    Result queued, latched;
+
+    run(true, trials, &queued);
+    run(false, trials, &latched);
+    printf("tick %d us, input every %d us\n", TICK_US, INPUT_US);
+    print("queue", queued);
+    print("latched", latched);
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include "touchpad.h"
+
+// Keypad codes the game steers with, 1 up, 6 right, 5 down, 4 left
+const PadLayout keypadLayout = {
+    { 0, 1, 0, 0, 4, 5, 6, 0, 0, 0, 0, 0 },
+    { 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2 },
+    { 0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3 },
+    { 0, 1, 0, 0, 1, 1, 1, 0, 0, 0, 0, 0 }
+};
+
+TouchDecoder::TouchDecoder(const PadLayout *layout, uint32_t (*clock)(void))
+{
+    this->layout = layout;
+    this->clock = clock;
+
+    for (int e = 0; e < TOUCH_ELECTRODES; e++) {
+        state[e] = PAD_UP;
+        since[e] = 0;
+    }
+    current = 0;
+    lastPad = -1;
+    lastPress = 0;
+    best = 0;
+    bestPriority = -128;
+    head = 0;
+    tail = 0;
+
+    updates = 0;
+    events = 0;
+    earlyPresses = 0;
+    dropped = 0;
+    lastUs = 0;
+    maxUs = 0;
+}
+
+void TouchDecoder::emit(int type, int electrode, int key)
+{
+    int h = (head + 1) & (TOUCH_EVENTS - 1);
+    if (h == tail) {
+        dropped++;
+        return;
+    }
+    queue[head].type = type;
+    queue[head].electrode = electrode;
+    queue[head].key = key;
+    head = h;
+    events++;
+}
+
+bool TouchDecoder::next(TouchEvent *e)
+{
+    if (tail == head)
+        return false;
+    *e = queue[tail];
+    tail = (tail + 1) & (TOUCH_EVENTS - 1);
+    return true;
+}
+
+// Direction of a move between neighbouring pads, 0 if they are not neighbours
+int TouchDecoder::slideKey(int from, int to) const
+{
+    int dc = layout->col[to] - layout->col[from];
+    int dr = layout->row[to] - layout->row[from];
+
+    if (dr == 0 && dc == 1)
+        return 6;
+    if (dr == 0 && dc == -1)
+        return 4;
+    if (dc == 0 && dr == 1)
+        return 5;
+    if (dc == 0 && dr == -1)
+        return 1;
+    return 0;
+}
+
+void TouchDecoder::update(unsigned int mask, uint32_t now_us)
+{
+    uint32_t start = clock ? clock() : 0;
+
+    int touched = (mask | (mask >> 16)) & ((1 << TOUCH_ELECTRODES) - 1);
+    int early = (mask >> 16) & ~mask & ((1 << TOUCH_ELECTRODES) - 1);
+
+    current = mask;
+    best = 0;
+    bestPriority = -128;
+    updates++;
+
+    for (int e = 0; e < TOUCH_ELECTRODES; e++) {
+        bool down = (touched >> e) & 1;
+
+        switch (state[e]) {
+            case PAD_UP:
+                if (!down)
+                    break;
+                state[e] = PAD_DOWN;
+                since[e] = now_us;
+                if ((early >> e) & 1)
+                    earlyPresses++;
+                emit(TOUCH_PRESS, e, layout->key[e]);
+
+                //a press next to the last one, soon enough, is a slide
+                if (lastPad >= 0 && lastPad != e && now_us - lastPress <= TOUCH_SLIDE_MS * 1000) {
+                    int k = slideKey(lastPad, e);
+                    if (k) {
+                        emit(TOUCH_SLIDE, e, k);
+                        best = k;
+                        bestPriority = 127;
+                    }
+                }
+                if (layout->key[e] && layout->priority[e] > bestPriority) {
+                    best = layout->key[e];
+                    bestPriority = layout->priority[e];
+                }
+                lastPad = e;
+                lastPress = now_us;
+                break;
+
+            case PAD_DOWN:
+                if (!down) {
+                    state[e] = PAD_UP;
+                    emit(TOUCH_TAP, e, layout->key[e]);
+                } else if (now_us - since[e] >= TOUCH_HOLD_MS * 1000) {
+                    state[e] = PAD_HELD;
+                    emit(TOUCH_HOLD, e, layout->key[e]);
+                }
+                break;
+
+            case PAD_HELD:
+                if (!down)
+                    state[e] = PAD_UP;
+                break;
+        }
+    }
+
+    if (clock) {
+        lastUs = clock() - start;
+        if (lastUs > maxUs)
+            maxUs = lastUs;
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef TOUCHPAD_H
+#define TOUCHPAD_H
+
+#include <stdint.h>
+
+// Electrodes on one MPR121
+#define TOUCH_ELECTRODES    12
+// Press held this long is a hold, shorter and released is a tap, in ms
+#define TOUCH_HOLD_MS       300
+// Press of a neighbouring pad within this time of the last one is a slide, in ms
+#define TOUCH_SLIDE_MS      150
+// Events kept until read, a power of two
+#define TOUCH_EVENTS        16
+
+// Event types
+#define TOUCH_PRESS         1
+#define TOUCH_TAP           2
+#define TOUCH_HOLD          3
+#define TOUCH_SLIDE         4
+
+struct TouchEvent
+{
+    char type;
+    char electrode;     // pad pressed, or where a slide ended
+    char key;           // keypad code, the direction of a slide, 0 for none
+};
+
+// Where the pads are and what they mean. A new keypad is a new table.
+struct PadLayout
+{
+    signed char key[TOUCH_ELECTRODES];      // keypad code, 0 for none
+    signed char col[TOUCH_ELECTRODES];      // position, neighbours differ by 1
+    signed char row[TOUCH_ELECTRODES];
+    signed char priority[TOUCH_ELECTRODES]; // among simultaneous presses, highest wins
+};
+
+// The 3x4 keypad the game ships with, electrodes in rows of three
+extern const PadLayout keypadLayout;
+
+// Turns raw electrode masks into taps, holds and slides.
+//
+// Every electrode runs a small state machine: up, down, held. A mask
+// comes from ControllerManager: bit n for electrode n touched, bit 16+n
+// for electrode n seen early in the filtered data. An early electrode is
+// taken as pressed, so a press is decoded a few samples before the chip
+// itself debounces it.
+//
+// key() gives the direction to steer with after each update: a slide wins
+// over presses, and among presses in the same sample the layout priority
+// decides. Pads still held from before never mask a new press.
+class TouchDecoder
+{
+public:
+    // clock gives microseconds, only used to time update() itself
+    TouchDecoder(const PadLayout *layout, uint32_t (*clock)(void) = 0);
+
+    // Feed one sample, taken at now_us on a wrapping microsecond clock
+    void update(unsigned int mask, uint32_t now_us);
+
+    // Same sample again, so holds are seen while nothing changes
+    void tick(uint32_t now_us) { update(current, now_us); }
+
+    // Steering code decided by the last update, 0 for none
+    int key() const { return best; }
+
+    // Next event, false when none
+    bool next(TouchEvent *e);
+
+    // Statistics
+    int updates;
+    int events;
+    int earlyPresses;   // presses seen in filtered data before the status bit
+    int dropped;        // events lost to a full queue
+    int lastUs;         // time spent in the last update()
+    int maxUs;
+
+private:
+    enum State { PAD_UP, PAD_DOWN, PAD_HELD };
+
+    void emit(int type, int electrode, int key);
+    int slideKey(int from, int to) const;
+
+    const PadLayout *layout;
+    uint32_t (*clock)(void);
+
+    unsigned int current;
+    unsigned char state[TOUCH_ELECTRODES];
+    uint32_t since[TOUCH_ELECTRODES];
+
+    // last pad pressed, for slides
+    int lastPad;
+    uint32_t lastPress;
+
+    int best;
+    int bestPriority;
+
+    TouchEvent queue[TOUCH_EVENTS];
+    int head;
+    int tail;
+};
+
+#endif